@@ -0,0 +1,88 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Measures the throughput of the DREAM expected-zone cone test: deciding
+ * which candidate neighbours lie in the cone from this node toward the
+ * circle in which the destination is expected to be.  "scalar" computes
+ * atan2/asin per candidate, "batched" is LocationTable::SelectInCone over
+ * columns of candidate positions.
+ *
+ * ./waf --run "dream-cone-benchmark --candidates=1024 --rounds=10000"
+ */
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/dream-location-table.h"
+
+using namespace ns3;
+
+/// Angle based cone test of a batch of points, kept as the baseline
+static uint32_t
+ScalarSelectInCone (const double *x, const double *y, uint32_t n, double sx, double sy,
+                    double dx, double dy, double r, uint8_t *inCone)
+{
+  double distance = std::sqrt ((dx - sx) * (dx - sx) + (dy - sy) * (dy - sy));
+  double alpha = r >= distance ? M_PI : std::asin (r / distance);
+  double theta = std::atan2 (dy - sy, dx - sx);
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double phi = std::atan2 (y[i] - sy, x[i] - sx);
+      inCone[i] = std::fabs (std::remainder (phi - theta, 2 * M_PI)) <= alpha;
+      count += inCone[i];
+    }
+  return count;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t candidates = 1024;
+  uint32_t rounds = 10000;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("candidates", "Number of candidate neighbours per cone test", candidates);
+  cmd.AddValue ("rounds", "Number of cone tests", rounds);
+  cmd.Parse (argc,argv);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  std::vector<double> x (candidates), y (candidates);
+  std::vector<uint8_t> inCone (candidates);
+  for (uint32_t i = 0; i < candidates; i++)
+    {
+      x[i] = rng->GetValue (0, 500);
+      y[i] = rng->GetValue (0, 500);
+    }
+  std::vector<double> dx (rounds), dy (rounds), r (rounds);
+  for (uint32_t i = 0; i < rounds; i++)
+    {
+      dx[i] = rng->GetValue (-2000, 2500);
+      dy[i] = rng->GetValue (-2000, 2500);
+      r[i] = rng->GetValue (0, 400);
+    }
+
+  uint64_t before = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < rounds; i++)
+    {
+      before += ScalarSelectInCone (x.data (), y.data (), candidates, 250, 250, dx[i], dy[i], r[i], inCone.data ());
+    }
+  double scalar = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  uint64_t after = 0;
+  start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < rounds; i++)
+    {
+      after += dream::LocationTable::SelectInCone (x.data (), y.data (), candidates, 250, 250, dx[i], dy[i], r[i], inCone.data ());
+    }
+  double batched = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  double tested = static_cast<double> (candidates) * rounds;
+  std::cout << "Candidates in cone: scalar " << before << ", batched " << after << " of " << tested << std::endl;
+  std::cout << "Candidates per second scalar:  " << tested / scalar << std::endl;
+  std::cout << "Candidates per second batched: " << tested / batched << std::endl;
+  return 0;
+}
@@ -0,0 +1,192 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Measures the route resolution DreamRoutingProtocol::RouteInput does for
+ * every packet a transit node forwards.  The node relays a number of flows
+ * while its neighbours keep refreshing every route once per periodic update
+ * interval; with a given probability a refresh moves the route to another
+ * next hop.
+ *
+ * "before" resolves every packet in the routing table, which takes one
+ * lookup for the destination and one for its next hop; "after" first
+ * probes the forwarding cache of the protocol, whose entries hold while
+ * the generation of the routing table is unchanged.  Refreshes that leave
+ * the next hop as it is do not change the generation.
+ *
+ * ./waf --run "dream-forwarding-cache-benchmark --routes=1000 --flows=20 --rate=500"
+ */
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/dream-rtable.h"
+
+using namespace ns3;
+
+/// Number of entries of the forwarding cache, as in DreamRoutingProtocol
+static const uint32_t CACHE_SIZE = 64;
+
+/// A forwarding decision, as in DreamRoutingProtocol
+struct CacheEntry
+{
+  Ipv4Address destination; ///< destination of the packets
+  uint64_t generation; ///< routing table generation the route was resolved in
+  Ptr<Ipv4Route> route; ///< route the packets are forwarded on
+};
+
+/// State of one run of the benchmark
+struct ForwardingRun
+{
+  bool cached; ///< true for the forwarding cache
+  dream::RoutingTable table; ///< routing table of the node
+  std::vector<dream::RoutingTableEntry> routes; ///< the routes, as learned
+  std::vector<CacheEntry> cache; ///< forwarding cache
+  std::vector<Ipv4Address> flows; ///< destination of every flow
+  Ptr<UniformRandomVariable> rng; ///< next hop changes
+  double changeProbability; ///< probability that a refresh changes the next hop
+  uint32_t neighbors; ///< number of one-hop neighbours among the routes
+  uint32_t packetsPerBatch; ///< packets forwarded every millisecond
+  uint64_t packets; ///< packets forwarded
+  uint64_t resolved; ///< packets for which a route was found
+  uint64_t hits; ///< packets forwarded from the cache
+  double seconds; ///< wall clock time spent resolving routes
+};
+
+/**
+ * Refresh a route, possibly through another next hop
+ * \param run the benchmark run
+ * \param i the index of the route
+ * \param interval the periodic update interval
+ */
+static void
+Refresh (ForwardingRun * run, uint32_t i, Time interval)
+{
+  dream::RoutingTableEntry & rt = run->routes[i];
+  rt.SetSeqNo (rt.GetSeqNo () + 2);
+  rt.SetLifeTime (Simulator::Now ());
+  if (rt.GetHop () > 1 && run->rng->GetValue () < run->changeProbability)
+    {
+      rt.SetNextHop (Ipv4Address (0x0a000000 + 1 + run->rng->GetInteger (0, run->neighbors - 1)));
+    }
+  run->table.Update (rt);
+  Simulator::Schedule (interval, &Refresh, run, i, interval);
+}
+
+/**
+ * Forward a batch of packets
+ * \param run the benchmark run
+ */
+static void
+ForwardBatch (ForwardingRun * run)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t p = 0; p < run->packetsPerBatch; p++)
+    {
+      Ipv4Address dst = run->flows[run->packets % run->flows.size ()];
+      run->packets++;
+      if (run->cached)
+        {
+          CacheEntry & entry = run->cache[Ipv4AddressHash () (dst) & (CACHE_SIZE - 1)];
+          if (entry.route != 0 && entry.destination == dst && entry.generation == run->table.GetGeneration ())
+            {
+              run->hits++;
+              run->resolved++;
+              continue;
+            }
+          Ptr<Ipv4Route> route = run->table.ResolveRoute (dst);
+          if (route != 0)
+            {
+              entry.destination = dst;
+              entry.generation = run->table.GetGeneration ();
+              entry.route = route;
+              run->resolved++;
+            }
+        }
+      else
+        {
+          run->resolved += (run->table.ResolveRoute (dst) != 0);
+        }
+    }
+  run->seconds += std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  Simulator::Schedule (MilliSeconds (1), &ForwardBatch, run);
+}
+
+/**
+ * Run the benchmark
+ * \param run the benchmark run, with its options set
+ * \param routes number of routes
+ * \param flows number of flows relayed by the node
+ * \param duration simulated time
+ */
+static void
+Run (ForwardingRun & run, uint32_t routes, uint32_t flows, Time duration)
+{
+  Time interval = Seconds (15);
+  run.table.Setholddowntime (3 * interval);
+  run.cache.resize (CACHE_SIZE);
+  run.rng = CreateObject<UniformRandomVariable> ();
+  // Same changes in both runs
+  run.rng->SetStream (1);
+  for (uint32_t i = 0; i < routes; i++)
+    {
+      Ipv4Address dst (0x0a000000 + 1 + i);
+      bool neighbor = i < run.neighbors;
+      Ipv4Address nextHop = neighbor ? dst : Ipv4Address (0x0a000000 + 1 + i % run.neighbors);
+      run.routes.push_back (dream::RoutingTableEntry (0, dst, 2 * i, Ipv4InterfaceAddress (),
+                                                      neighbor ? 1 : 2 + i % 6, nextHop, Seconds (0)));
+      run.table.AddRoute (run.routes.back ());
+      Simulator::Schedule (Seconds (run.rng->GetValue (0, interval.GetSeconds ())), &Refresh, &run, i, interval);
+    }
+  for (uint32_t f = 0; f < flows; f++)
+    {
+      run.flows.push_back (Ipv4Address (0x0a000000 + 1 + (f * 37) % routes));
+    }
+  Simulator::Schedule (MilliSeconds (1), &ForwardBatch, &run);
+  Simulator::Stop (duration);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t routes = 1000;
+  uint32_t neighbors = 50;
+  uint32_t flows = 20;
+  uint32_t rate = 500;
+  double change = 0.05;
+  double duration = 120;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("routes", "Number of routes in the table", routes);
+  cmd.AddValue ("neighbors", "Number of one-hop neighbours among the routes", neighbors);
+  cmd.AddValue ("flows", "Number of flows relayed by the node", flows);
+  cmd.AddValue ("rate", "Packets per second of every flow", rate);
+  cmd.AddValue ("change", "Probability that a refresh changes the next hop of a route", change);
+  cmd.AddValue ("duration", "Simulated time, in seconds", duration);
+  cmd.Parse (argc,argv);
+
+  ForwardingRun before;
+  ForwardingRun after;
+  ForwardingRun *runs[] = { &before, &after };
+  for (uint32_t r = 0; r < 2; r++)
+    {
+      runs[r]->cached = (r == 1);
+      runs[r]->changeProbability = change;
+      runs[r]->neighbors = neighbors;
+      runs[r]->packetsPerBatch = std::max (1u, flows * rate / 1000);
+      runs[r]->packets = 0;
+      runs[r]->resolved = 0;
+      runs[r]->hits = 0;
+      runs[r]->seconds = 0;
+      Run (*runs[r], routes, flows, Seconds (duration));
+    }
+
+  std::cout << "Packets forwarded: " << after.packets << std::endl;
+  std::cout << "Routes resolved before: " << before.resolved << " after: " << after.resolved << std::endl;
+  std::cout << "Forwarding cache hit ratio: " << (double) after.hits / after.packets << std::endl;
+  std::cout << "Time per packet before: " << 1e9 * before.seconds / before.packets << " ns"
+            << " after: " << 1e9 * after.seconds / after.packets << " ns" << std::endl;
+  return 0;
+}
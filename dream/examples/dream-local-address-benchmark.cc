@@ -0,0 +1,225 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Measures the own address checks of a node with several radios, for 4
+ * to 8 dream interfaces.  For every record of a received update
+ * DreamRoutingProtocol::RecvDream checks whether the destination is one of
+ * the node's addresses; for every data packet RouteInput checks whether the
+ * origin is one of them and whether the destination is a broadcast address
+ * of the input interface.
+ *
+ * "before" walks the socket map for every check and looks the interface
+ * index of every address up, as Ipv4L3Protocol::GetInterfaceForAddress
+ * does; "after" searches the sorted local and broadcast address sets that
+ * the protocol rebuilds when an interface or an address changes.
+ *
+ * ./waf --run "dream-local-address-benchmark --records=1000 --packets=1000000"
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/ipv4-interface-address.h"
+
+using namespace ns3;
+
+/// The interfaces of the node
+struct LocalInterfaces
+{
+  std::vector<Ipv4InterfaceAddress> interfaces; ///< address of every interface, by index
+  std::map<Ptr<Object>, Ipv4InterfaceAddress> socketAddresses; ///< socket map of the protocol
+  std::vector<Ipv4Address> localAddresses; ///< sorted local addresses
+  std::vector<std::pair<int32_t, Ipv4Address> > localBroadcasts; ///< sorted interface and broadcast addresses
+};
+
+/**
+ * Look the interface of an address up the way Ipv4L3Protocol does
+ * \param node the interfaces of the node
+ * \param address the address
+ * \return the interface index, -1 if none
+ */
+static int32_t
+GetInterfaceForAddress (LocalInterfaces const & node, Ipv4Address address)
+{
+  for (uint32_t i = 0; i < node.interfaces.size (); i++)
+    {
+      if (node.interfaces[i].GetLocal () == address)
+        {
+          return i;
+        }
+    }
+  return -1;
+}
+
+/**
+ * Check an address against the socket map, as RecvDream and RouteInput did
+ * \param node the interfaces of the node
+ * \param address the address
+ * \return true if the address is ours
+ */
+static bool
+IsLocalAddressBefore (LocalInterfaces const & node, Ipv4Address address)
+{
+  for (std::map<Ptr<Object>, Ipv4InterfaceAddress>::const_iterator j = node.socketAddresses.begin (); j
+       != node.socketAddresses.end (); ++j)
+    {
+      if (address == j->second.GetLocal ())
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+/**
+ * Check a destination against the socket map, as RouteInput did
+ * \param node the interfaces of the node
+ * \param dst the destination
+ * \param iif the input interface
+ * \return true if the packet is a broadcast on the input interface
+ */
+static bool
+IsLocalBroadcastBefore (LocalInterfaces const & node, Ipv4Address dst, int32_t iif)
+{
+  for (std::map<Ptr<Object>, Ipv4InterfaceAddress>::const_iterator j = node.socketAddresses.begin (); j
+       != node.socketAddresses.end (); ++j)
+    {
+      Ipv4InterfaceAddress iface = j->second;
+      if (GetInterfaceForAddress (node, iface.GetLocal ()) == iif)
+        {
+          if (dst == iface.GetBroadcast () || dst.IsBroadcast ())
+            {
+              return true;
+            }
+        }
+    }
+  return false;
+}
+
+/**
+ * Check an address against the local address set
+ * \param node the interfaces of the node
+ * \param address the address
+ * \return true if the address is ours
+ */
+static bool
+IsLocalAddressAfter (LocalInterfaces const & node, Ipv4Address address)
+{
+  return std::binary_search (node.localAddresses.begin (), node.localAddresses.end (), address);
+}
+
+/**
+ * Check a destination against the broadcast address set
+ * \param node the interfaces of the node
+ * \param dst the destination
+ * \param iif the input interface
+ * \return true if the packet is a broadcast on the input interface
+ */
+static bool
+IsLocalBroadcastAfter (LocalInterfaces const & node, Ipv4Address dst, int32_t iif)
+{
+  std::vector<std::pair<int32_t, Ipv4Address> >::const_iterator i =
+    std::lower_bound (node.localBroadcasts.begin (), node.localBroadcasts.end (),
+                      std::make_pair (iif, dst.IsBroadcast () ? Ipv4Address ((uint32_t) 0) : dst));
+  if (i == node.localBroadcasts.end () || i->first != iif)
+    {
+      return false;
+    }
+  return dst.IsBroadcast () || i->second == dst;
+}
+
+/**
+ * Build the interfaces of a node
+ * \param node the interfaces to fill
+ * \param radios the number of dream interfaces
+ */
+static void
+Build (LocalInterfaces & node, uint32_t radios)
+{
+  // Interface 0 is the loopback, which has no dream socket
+  node.interfaces.push_back (Ipv4InterfaceAddress (Ipv4Address ("127.0.0.1"), Ipv4Mask ("255.0.0.0")));
+  for (uint32_t r = 0; r < radios; r++)
+    {
+      Ipv4InterfaceAddress iface (Ipv4Address (0x0a000000 + (r << 16) + 7), Ipv4Mask ("255.255.0.0"));
+      node.interfaces.push_back (iface);
+      node.socketAddresses.insert (std::make_pair (CreateObject<Object> (), iface));
+      node.localAddresses.push_back (iface.GetLocal ());
+      node.localBroadcasts.push_back (std::make_pair (r + 1, iface.GetBroadcast ()));
+    }
+  std::sort (node.localAddresses.begin (), node.localAddresses.end ());
+  std::sort (node.localBroadcasts.begin (), node.localBroadcasts.end ());
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t records = 1000;
+  uint32_t packets = 1000000;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("records", "Number of update records checked per radio count", records);
+  cmd.AddValue ("packets", "Number of data packets checked per radio count", packets);
+  cmd.Parse (argc,argv);
+
+  for (uint32_t radios = 4; radios <= 8; radios++)
+    {
+      LocalInterfaces node;
+      Build (node, radios);
+      // Destinations of the update records and origins and destinations of
+      // the data packets: one in a hundred is ours, one in ten a broadcast
+      std::vector<Ipv4Address> addresses;
+      for (uint32_t i = 0; i < 1000; i++)
+        {
+          uint32_t subnet = (i % radios) << 16;
+          if (i % 100 == 0)
+            {
+              addresses.push_back (Ipv4Address (0x0a000000 + subnet + 7));
+            }
+          else if (i % 10 == 0)
+            {
+              addresses.push_back (i % 20 == 0 ? Ipv4Address ("255.255.255.255")
+                                   : Ipv4Address (0x0a00ffff + subnet));
+            }
+          else
+            {
+              addresses.push_back (Ipv4Address (0x0a000000 + subnet + 8 + i));
+            }
+        }
+
+      double seconds[2];
+      uint64_t matches[2];
+      for (uint32_t r = 0; r < 2; r++)
+        {
+          bool after = (r == 1);
+          matches[r] = 0;
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+          for (uint32_t i = 0; i < records; i++)
+            {
+              Ipv4Address dst = addresses[i % addresses.size ()];
+              matches[r] += after ? IsLocalAddressAfter (node, dst) : IsLocalAddressBefore (node, dst);
+            }
+          for (uint32_t i = 0; i < packets; i++)
+            {
+              Ipv4Address origin = addresses[(i * 7) % addresses.size ()];
+              Ipv4Address dst = addresses[i % addresses.size ()];
+              int32_t iif = 1 + i % radios;
+              if (after ? IsLocalAddressAfter (node, origin) : IsLocalAddressBefore (node, origin))
+                {
+                  matches[r]++;
+                  continue;
+                }
+              matches[r] += after ? IsLocalBroadcastAfter (node, dst, iif)
+                : IsLocalBroadcastBefore (node, dst, iif);
+            }
+          seconds[r] = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+        }
+      NS_ABORT_MSG_IF (matches[0] != matches[1], "The address sets disagree with the socket map");
+      std::cout << "Radios: " << radios << " checks: " << records + packets
+                << " time per check before: " << 1e9 * seconds[0] / (records + packets) << " ns"
+                << " after: " << 1e9 * seconds[1] / (records + packets) << " ns" << std::endl;
+    }
+  return 0;
+}
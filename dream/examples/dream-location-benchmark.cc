@@ -0,0 +1,161 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Measures the location work of DreamRoutingProtocol::RecvDream with 100,
+ * 1000 and 10000 nodes placed at constant density.  "before" is the former
+ * std::map store, scanned in full to store the location of a sender and
+ * to pick the closest node for every received record.  "after" is the
+ * grid based LocationTable: RoutingTable::AddMobilityData for the sender
+ * of an update, and RoutingTable::IsBetterGeographicNextHop, the neighbour
+ * query run for an equal cost advertisement when EnableGeographicNextHop
+ * is set.
+ *
+ * ./waf --run "dream-location-benchmark --operations=10000"
+ */
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/dream-rtable.h"
+
+using namespace ns3;
+
+typedef std::map<Ipv4Address, std::tuple<uint32_t, uint32_t, float> > LocationMap;
+
+/// The former RoutingTable::AddMobilityData, kept as the baseline
+static void
+LegacyAddMobilityData (LocationMap & locations, Ipv4Address src, uint32_t x, uint32_t y, float v)
+{
+  for (LocationMap::const_iterator i = locations.begin (); i != locations.end (); ++i)
+    {
+      if (i->first == src)
+        {
+          // The former code went on iterating from the erased element
+          locations.erase (i);
+          break;
+        }
+    }
+  locations.insert ({src, std::make_tuple (x, y, v)});
+}
+
+/// The former RoutingTable::getClosestAddress, kept as the baseline
+static Ipv4Address
+LegacyGetClosestAddress (LocationMap const & locations, Ipv4Address src)
+{
+  uint32_t x = 0, y = 0;
+  Ipv4Address address = Ipv4Address ();
+  float v = 0.0;
+  for (LocationMap::const_iterator i = locations.begin (); i != locations.end (); ++i)
+    {
+      if (i->first == src)
+        {
+          x = std::get<0> (i->second);
+          y = std::get<1> (i->second);
+          v = std::get<2> (i->second);
+        }
+    }
+  if (x == 0 && y == 0 && v == 0.0)
+    {
+      return Ipv4Address ();
+    }
+  float theta = std::atan (y / x);
+  float min = -999999999.99;
+  for (LocationMap::const_iterator i = locations.begin (); i != locations.end (); ++i)
+    {
+      if (i->first != src)
+        {
+          x = std::get<0> (i->second);
+          y = std::get<1> (i->second);
+          v = std::get<2> (i->second);
+          float alpha = std::asin (v * 0.000000015 / std::sqrt (x * x + y * y));
+          if (std::abs (alpha - theta) < min)
+            {
+              min = alpha;
+              address = i->first;
+            }
+        }
+    }
+  return address;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t operations = 10000;
+  double density = 50.0;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("operations", "Number of location updates and of next hop queries per run", operations);
+  cmd.AddValue ("density", "Number of nodes per square kilometer", density);
+  cmd.Parse (argc,argv);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  uint32_t sizes[] = { 100, 1000, 10000 };
+  for (uint32_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); s++)
+    {
+      uint32_t nodes = sizes[s];
+      // Coordinates start at 1 so that the baseline does not divide by zero
+      double side = 1000.0 * std::sqrt (nodes / density);
+      LocationMap legacy;
+      dream::RoutingTable table;
+      for (uint32_t i = 0; i < nodes; i++)
+        {
+          Ipv4Address node (0x0a000000 + 1 + i);
+          uint32_t x = 1 + rng->GetInteger (0, side), y = 1 + rng->GetInteger (0, side);
+          LegacyAddMobilityData (legacy, node, x, y, 20);
+          table.AddMobilityData (node, x, y, 20);
+          dream::RoutingTableEntry rt (0, node, 2, Ipv4InterfaceAddress (), 1, node);
+          table.AddRoute (rt);
+        }
+      std::vector<Ipv4Address> sources, destinations, candidates;
+      std::vector<uint32_t> xs, ys;
+      for (uint32_t i = 0; i < operations; i++)
+        {
+          sources.push_back (Ipv4Address (0x0a000000 + 1 + rng->GetInteger (0, nodes - 1)));
+          destinations.push_back (Ipv4Address (0x0a000000 + 1 + rng->GetInteger (0, nodes - 1)));
+          candidates.push_back (Ipv4Address (0x0a000000 + 1 + rng->GetInteger (0, nodes - 1)));
+          xs.push_back (1 + rng->GetInteger (0, side));
+          ys.push_back (1 + rng->GetInteger (0, side));
+        }
+      Ipv4Address self = sources[0];
+
+      uint64_t found = 0;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      for (uint32_t i = 0; i < operations; i++)
+        {
+          LegacyAddMobilityData (legacy, sources[i], xs[i], ys[i], 20);
+        }
+      double updateBefore = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+      start = std::chrono::steady_clock::now ();
+      for (uint32_t i = 0; i < operations; i++)
+        {
+          found += (LegacyGetClosestAddress (legacy, destinations[i]) != Ipv4Address ());
+        }
+      double queryBefore = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+      start = std::chrono::steady_clock::now ();
+      for (uint32_t i = 0; i < operations; i++)
+        {
+          table.AddMobilityData (sources[i], xs[i], ys[i], 20);
+        }
+      double updateAfter = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+      start = std::chrono::steady_clock::now ();
+      for (uint32_t i = 0; i < operations; i++)
+        {
+          found += table.IsBetterGeographicNextHop (destinations[i], self, candidates[i], sources[i]);
+        }
+      double queryAfter = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+      NS_ABORT_MSG_IF (legacy.size () != table.GetLocationTable ().GetSize (), "Location stores differ in size");
+      std::cout << nodes << " nodes (" << found << " next hops found)" << std::endl;
+      std::cout << "  Updates per second before: " << operations / updateBefore
+                << ", after: " << operations / updateAfter << std::endl;
+      std::cout << "  Queries per second before: " << operations / queryBefore
+                << ", after: " << operations / queryAfter << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,145 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Measures the routing table work that DreamRoutingProtocol::RouteOutput
+ * performs for every locally originated packet -- RoutingTable::Purge
+ * followed by resolving the route to the destination -- on a table of
+ * 1000 routes.  "before" is the former full-table scan (with a rescan of
+ * the table for the dependents of every expired route) over a std::map,
+ * "after" is the current RoutingTable with its expiry queue and next hop
+ * index.  A fraction of the routes is made to expire so that both paths
+ * also remove routes and their dependents.
+ *
+ * ./waf --run "dream-purge-benchmark --routes=1000 --packets=100000"
+ */
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/dream-rtable.h"
+
+using namespace ns3;
+
+typedef std::map<Ipv4Address, dream::RoutingTableEntry> RouteMap;
+
+/// The Purge of the std::map based routing table, kept as the baseline
+static void
+LegacyPurge (RouteMap & table, Time holddownTime, RouteMap & removedAddresses)
+{
+  for (RouteMap::iterator i = table.begin (); i != table.end (); )
+    {
+      RouteMap::iterator itmp = i;
+      if (i->second.GetLifeTime () > holddownTime && (i->second.GetHop () > 0))
+        {
+          for (RouteMap::iterator j = table.begin (); j != table.end (); )
+            {
+              if ((j->second.GetNextHop () == i->second.GetDestination ()) && (i->second.GetHop () != j->second.GetHop ()))
+                {
+                  RouteMap::iterator jtmp = j;
+                  removedAddresses.insert (std::make_pair (j->first,j->second));
+                  ++j;
+                  table.erase (jtmp);
+                }
+              else
+                {
+                  ++j;
+                }
+            }
+          removedAddresses.insert (std::make_pair (i->first,i->second));
+          ++i;
+          table.erase (itmp);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+/// The route lookup of the std::map based RouteOutput
+static Ptr<Ipv4Route>
+LegacyLookup (RouteMap const & table, Ipv4Address dst)
+{
+  RouteMap::const_iterator i = table.find (dst);
+  if (i == table.end ())
+    {
+      return 0;
+    }
+  dream::RoutingTableEntry rt = i->second;
+  if (rt.GetHop () == 1)
+    {
+      return rt.GetRoute ();
+    }
+  RouteMap::const_iterator nh = table.find (rt.GetNextHop ());
+  if (nh == table.end ())
+    {
+      return 0;
+    }
+  dream::RoutingTableEntry newrt = nh->second;
+  return newrt.GetRoute ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t routes = 1000;
+  uint32_t neighbors = 50;
+  uint32_t packets = 100000;
+  double expiredFraction = 0.01;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("routes", "Number of routes in the table", routes);
+  cmd.AddValue ("neighbors", "Number of one-hop neighbours among the routes", neighbors);
+  cmd.AddValue ("packets", "Number of packets sent", packets);
+  cmd.AddValue ("expired", "Fraction of routes that have already expired", expiredFraction);
+  cmd.Parse (argc,argv);
+
+  Time holddownTime = Seconds (45);
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+
+  RouteMap legacy;
+  dream::RoutingTable table;
+  table.Setholddowntime (holddownTime);
+  std::vector<Ipv4Address> destinations;
+  for (uint32_t i = 0; i < routes; i++)
+    {
+      Ipv4Address dst (0x0a000000 + 1 + i);
+      bool neighbor = i < neighbors;
+      Ipv4Address nextHop = neighbor ? dst : Ipv4Address (0x0a000000 + 1 + rng->GetInteger (0, neighbors - 1));
+      // Lifetime is the time of the last update, so a route is expired once it is older than the hold down time
+      double age = rng->GetValue () < expiredFraction ? 60.0 : rng->GetValue (0.0, 30.0);
+      dream::RoutingTableEntry rt (0, dst, 2 * i, Ipv4InterfaceAddress (), neighbor ? 1 : 2 + i % 6, nextHop,
+                                   Simulator::Now () - Seconds (age));
+      legacy.insert (std::make_pair (dst, rt));
+      table.AddRoute (rt);
+      destinations.push_back (dst);
+    }
+
+  uint64_t found = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < packets; i++)
+    {
+      RouteMap removedAddresses;
+      LegacyPurge (legacy, holddownTime, removedAddresses);
+      found += (LegacyLookup (legacy, destinations[i % routes]) != 0);
+    }
+  double before = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < packets; i++)
+    {
+      RouteMap removedAddresses;
+      table.Purge (removedAddresses);
+      found += (table.ResolveRoute (destinations[i % routes]) != 0);
+    }
+  double after = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  NS_ABORT_MSG_IF (legacy.size () != table.RoutingTableSize (), "Purge removed different routes");
+  std::cout << "Routes left after purge: " << table.RoutingTableSize () << " of " << routes << std::endl;
+  std::cout << "Routes resolved: " << found << std::endl;
+  std::cout << "Time per RouteOutput before: " << 1e9 * before / packets << " ns" << std::endl;
+  std::cout << "Time per RouteOutput after:  " << 1e9 * after / packets << " ns" << std::endl;
+  return 0;
+}
@@ -0,0 +1,212 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Measures the route-wait queue of DREAM when it is under pressure: a
+ * number of flows keep buffering packets while they have no route, and
+ * then the route of every flow appears and its backlog is drained.
+ * "before" is the former std::vector queue, which purged the whole queue
+ * and scanned it on every operation, "after" is the current PacketQueue.
+ *
+ * The second measurement keeps a fair share queue of one packet per
+ * destination full, so that every new packet evicts one. It bounds the cost
+ * of picking the destination with the most packets as destinations grow.
+ *
+ * ./waf --run "dream-queue-benchmark --flows=40 --packets=500 --rounds=200 --destinations=1000"
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/dream-packet-queue.h"
+
+using namespace ns3;
+
+/// The std::vector based queue, kept as the baseline
+class LegacyPacketQueue
+{
+public:
+  /**
+   * \param maxLen the maximum number of packets
+   * \param maxLenPerDst the maximum number of packets per destination
+   * \param timeout the queue timeout
+   */
+  LegacyPacketQueue (uint32_t maxLen, uint32_t maxLenPerDst, Time timeout)
+    : m_maxLen (maxLen),
+      m_maxLenPerDst (maxLenPerDst),
+      m_timeout (timeout)
+  {
+  }
+  /**
+   * \param entry the entry
+   * \return true if queued
+   */
+  bool Enqueue (dream::QueueEntry & entry)
+  {
+    Purge ();
+    for (std::vector<dream::QueueEntry>::const_iterator i = m_queue.begin (); i != m_queue.end (); ++i)
+      {
+        if ((i->GetPacket ()->GetUid () == entry.GetPacket ()->GetUid ())
+            && (i->GetIpv4Header ().GetDestination () == entry.GetIpv4Header ().GetDestination ()))
+          {
+            return false;
+          }
+      }
+    uint32_t count = 0;
+    for (std::vector<dream::QueueEntry>::const_iterator i = m_queue.begin (); i != m_queue.end (); ++i)
+      {
+        count += (i->GetIpv4Header ().GetDestination () == entry.GetIpv4Header ().GetDestination ());
+      }
+    if (count >= m_maxLenPerDst || m_queue.size () >= m_maxLen)
+      {
+        return false;
+      }
+    entry.SetExpireTime (m_timeout);
+    m_queue.push_back (entry);
+    return true;
+  }
+  /**
+   * \param dst the destination
+   * \param entry the dequeued entry
+   * \return true if an entry was dequeued
+   */
+  bool Dequeue (Ipv4Address dst, dream::QueueEntry & entry)
+  {
+    Purge ();
+    for (std::vector<dream::QueueEntry>::iterator i = m_queue.begin (); i != m_queue.end (); ++i)
+      {
+        if (i->GetIpv4Header ().GetDestination () == dst)
+          {
+            entry = *i;
+            m_queue.erase (i);
+            return true;
+          }
+      }
+    return false;
+  }
+
+private:
+  /// Remove the expired entries
+  void Purge ()
+  {
+    m_queue.erase (std::remove_if (m_queue.begin (), m_queue.end (),
+                                   [] (dream::QueueEntry const & e) { return e.GetExpireTime () < Seconds (0); }),
+                   m_queue.end ());
+  }
+
+  std::vector<dream::QueueEntry> m_queue; ///< the queue
+  uint32_t m_maxLen; ///< the maximum number of packets
+  uint32_t m_maxLenPerDst; ///< the maximum number of packets per destination
+  Time m_timeout; ///< the queue timeout
+};
+
+/**
+ * Fill the queue from every flow and drain it again
+ * \param queue the queue
+ * \param entries the packets, flow after flow
+ * \param flows the number of flows
+ * \return the number of packets drained
+ */
+template <typename Q>
+static uint32_t
+FillAndDrain (Q & queue, std::vector<dream::QueueEntry> & entries, uint32_t flows)
+{
+  uint32_t drained = 0;
+  for (std::vector<dream::QueueEntry>::iterator i = entries.begin (); i != entries.end (); ++i)
+    {
+      queue.Enqueue (*i);
+    }
+  dream::QueueEntry entry;
+  for (uint32_t f = 0; f < flows; f++)
+    {
+      while (queue.Dequeue (Ipv4Address (0x0a000001 + f), entry))
+        {
+          drained++;
+        }
+    }
+  return drained;
+}
+
+/**
+ * Enqueue packets round robin over the destinations into a full fair share queue
+ * \param destinations the number of destinations, which is also the queue length
+ * \param packets the number of packets to enqueue
+ * \return the packets enqueued per second
+ */
+static double
+MeasureFairShareEvictions (uint32_t destinations, uint32_t packets)
+{
+  dream::PacketQueue queue;
+  queue.SetQueuePolicy (dream::QUEUE_FAIR_SHARE);
+  queue.SetMaxQueueLen (destinations);
+  queue.SetMaxPacketsPerDst (packets);
+  queue.SetQueueTimeout (Seconds (30));
+  Ipv4Header header;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < packets; i++)
+    {
+      header.SetDestination (Ipv4Address (0x0a000001 + i % destinations));
+      dream::QueueEntry entry (Create<Packet> (64), header);
+      queue.Enqueue (entry);
+    }
+  double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  NS_ABORT_MSG_IF (queue.GetSize () != destinations, "Fair share queue not kept full");
+  return packets / elapsed;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t flows = 40;
+  uint32_t packets = 500;
+  uint32_t rounds = 200;
+  uint32_t destinations = 1000;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("flows", "Number of flows waiting for a route", flows);
+  cmd.AddValue ("packets", "Number of packets buffered in total", packets);
+  cmd.AddValue ("rounds", "Number of times the queue is filled and drained", rounds);
+  cmd.AddValue ("destinations", "Number of destinations of the fair share eviction measurement", destinations);
+  cmd.Parse (argc,argv);
+
+  std::vector<dream::QueueEntry> entries;
+  for (uint32_t i = 0; i < packets; i++)
+    {
+      Ipv4Header header;
+      header.SetDestination (Ipv4Address (0x0a000001 + i % flows));
+      entries.push_back (dream::QueueEntry (Create<Packet> (64), header));
+    }
+  uint32_t perDst = (packets + flows - 1) / flows;
+
+  LegacyPacketQueue legacy (packets, perDst, Seconds (30));
+  uint64_t drainedBefore = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t r = 0; r < rounds; r++)
+    {
+      drainedBefore += FillAndDrain (legacy, entries, flows);
+    }
+  double before = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  dream::PacketQueue queue;
+  queue.SetMaxQueueLen (packets);
+  queue.SetMaxPacketsPerDst (perDst);
+  queue.SetQueueTimeout (Seconds (30));
+  uint64_t drainedAfter = 0;
+  start = std::chrono::steady_clock::now ();
+  for (uint32_t r = 0; r < rounds; r++)
+    {
+      drainedAfter += FillAndDrain (queue, entries, flows);
+    }
+  double after = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  double evictions = MeasureFairShareEvictions (destinations, 100 * destinations);
+  Simulator::Destroy ();
+
+  NS_ABORT_MSG_IF (drainedBefore != drainedAfter, "Queues drained different packets");
+  std::cout << "Packets buffered and drained: " << drainedAfter << std::endl;
+  std::cout << "Packets per second before: " << drainedBefore / before << std::endl;
+  std::cout << "Packets per second after:  " << drainedAfter / after << std::endl;
+  std::cout << "Fair share evictions per second, " << destinations << " destinations: " << evictions << std::endl;
+  return 0;
+}
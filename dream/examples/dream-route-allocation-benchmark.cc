@@ -0,0 +1,255 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Measures the heap allocations made by the routing table entries of one
+ * node of a large network, with eager and lazy route allocation.  The node
+ * knows every other node; each of its neighbours sends a full dump every
+ * periodic update interval, and every record goes through the same table
+ * operations as in DreamRoutingProtocol::RecvDream.  Triggered updates
+ * take the changed advertisements out once per second.
+ *
+ * "before" allocates a new Ipv4Route for every entry, default constructed
+ * ones included; "after" lets default constructed entries go without a
+ * route until one is set.  The resident set size growth of each run is
+ * measured while both tables are alive.
+ *
+ * ./waf --run "dream-route-allocation-benchmark --nodes=1000 --neighbors=10"
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <unistd.h>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/dream-rtable.h"
+
+using namespace ns3;
+
+/// Number of calls to the global operator new
+static uint64_t g_heapAllocations = 0;
+
+void *
+operator new (std::size_t size)
+{
+  g_heapAllocations++;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+/**
+ * Get the resident set size of the process
+ * \return the size in bytes
+ */
+static uint64_t
+ResidentBytes ()
+{
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  std::ifstream statm ("/proc/self/statm");
+  statm >> size >> resident;
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+/// State of one run of the benchmark
+struct AllocationRun
+{
+  bool lazy; ///< true for entries without a route until one is set
+  dream::RoutingTable table; ///< routing table of the node
+  uint64_t records; ///< update records processed
+  uint64_t heapAllocations; ///< calls to operator new
+  int64_t residentGrowth; ///< growth of the resident set size
+  double seconds; ///< wall clock time
+};
+
+/**
+ * A default constructed entry, as used for the target of a lookup
+ * \param run the benchmark run
+ * \return the entry
+ */
+static dream::RoutingTableEntry
+EmptyEntry (AllocationRun const & run)
+{
+  // The former default constructor allocated a route
+  return run.lazy ? dream::RoutingTableEntry () : dream::RoutingTableEntry (0);
+}
+
+/**
+ * Process one update record the way RecvDream does
+ * \param run the benchmark run
+ * \param dst advertised destination
+ * \param seqNo advertised sequence number
+ * \param hops advertised hop count
+ * \param sender the neighbour the update came from
+ */
+static void
+Receive (AllocationRun & run, Ipv4Address dst, uint32_t seqNo, uint32_t hops, Ipv4Address sender)
+{
+  run.records++;
+  dream::DestinationRecord *destination = run.table.FindRecord (dst);
+  if (destination == 0 || !destination->HasRoute ())
+    {
+      dream::RoutingTableEntry newEntry (0, dst, seqNo, Ipv4InterfaceAddress (), hops, sender,
+                                         Simulator::Now (), Seconds (5), true);
+      if (destination == 0)
+        {
+          destination = &run.table.AddRecord (dst);
+        }
+      run.table.SetRoute (*destination, newEntry);
+      if (!destination->HasAdvertisement ())
+        {
+          run.table.SetAdvertisement (*destination, newEntry);
+        }
+      return;
+    }
+  if (!destination->HasAdvertisement ())
+    {
+      run.table.SetAdvertisement (*destination, destination->GetRouteEntry ());
+    }
+  dream::RoutingTableEntry advTableEntry = destination->GetAdvertisement ();
+  if (seqNo > advTableEntry.GetSeqNo () || (seqNo == advTableEntry.GetSeqNo () && hops < advTableEntry.GetHop ()))
+    {
+      advTableEntry.SetSeqNo (seqNo);
+      advTableEntry.SetLifeTime (Simulator::Now ());
+      advTableEntry.SetEntriesChanged (true);
+      advTableEntry.SetNextHop (sender);
+      advTableEntry.SetHop (hops);
+      run.table.SetRoute (*destination, advTableEntry);
+      run.table.SetAdvertisement (*destination, advTableEntry);
+    }
+  else
+    {
+      if (advTableEntry.GetNextHop () == sender)
+        {
+          advTableEntry.SetLifeTime (Simulator::Now ());
+          run.table.SetRoute (*destination, advTableEntry);
+        }
+      run.table.DeleteAdvertisement (*destination);
+    }
+}
+
+/**
+ * Send a triggered update the way SendTriggeredUpdate does
+ * \param run the benchmark run
+ */
+static void
+Trigger (AllocationRun * run)
+{
+  std::vector<dream::RoutingTableEntry> ready;
+  run->table.TakeChangedRoutes (ready);
+  for (std::vector<dream::RoutingTableEntry>::iterator i = ready.begin (); i != ready.end (); ++i)
+    {
+      run->table.Update (*i);
+    }
+  dream::RoutingTableEntry own = EmptyEntry (*run);
+  run->table.LookupRoute (Ipv4Address ("10.255.255.255"), own);
+  Simulator::Schedule (Seconds (1), &Trigger, run);
+}
+
+/**
+ * Receive a full dump from a neighbour
+ * \param run the benchmark run
+ * \param neighbor the index of the neighbour
+ * \param nodes the number of nodes
+ * \param rng hop count of the neighbour to every destination
+ * \param interval the periodic update interval
+ */
+static void
+ReceiveDump (AllocationRun * run, uint32_t neighbor, uint32_t nodes, Ptr<UniformRandomVariable> rng, Time interval)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  Ipv4Address sender (0x0a000000 + 1 + neighbor);
+  // Every origin bumps its sequence number once per interval
+  uint32_t seqNo = 2 * (uint32_t)(Simulator::Now ().GetSeconds () / interval.GetSeconds ());
+  for (uint32_t i = 0; i < nodes; i++)
+    {
+      Ipv4Address dst (0x0a000000 + 1 + i);
+      uint32_t hops = dst == sender ? 1 : rng->GetInteger (2, 8);
+      Receive (*run, dst, seqNo, hops, sender);
+      dream::RoutingTableEntry lookup = EmptyEntry (*run);
+      run->table.LookupRoute (dst, lookup);
+    }
+  run->seconds += std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  Simulator::Schedule (interval, &ReceiveDump, run, neighbor, nodes, rng, interval);
+}
+
+/**
+ * Run the benchmark
+ * \param run the benchmark run, with its options set
+ * \param nodes the number of nodes
+ * \param neighbors the number of neighbours of the node
+ * \param duration simulated time
+ */
+static void
+Run (AllocationRun & run, uint32_t nodes, uint32_t neighbors, Time duration)
+{
+  Time interval = Seconds (15);
+  run.table.Setholddowntime (3 * interval);
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (1);
+  uint64_t resident = ResidentBytes ();
+  uint64_t heapAllocations = g_heapAllocations;
+  for (uint32_t n = 0; n < neighbors; n++)
+    {
+      Simulator::Schedule (Seconds (rng->GetValue (0, interval.GetSeconds ())), &ReceiveDump, &run, n, nodes, rng,
+                           interval);
+    }
+  Simulator::Schedule (Seconds (1), &Trigger, &run);
+  Simulator::Stop (duration);
+  Simulator::Run ();
+  Simulator::Destroy ();
+  run.heapAllocations = g_heapAllocations - heapAllocations;
+  run.residentGrowth = (int64_t) ResidentBytes () - (int64_t) resident;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nodes = 1000;
+  uint32_t neighbors = 10;
+  double duration = 300;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("nodes", "Number of nodes in the network", nodes);
+  cmd.AddValue ("neighbors", "Number of neighbours of the node", neighbors);
+  cmd.AddValue ("duration", "Simulated time, in seconds", duration);
+  cmd.Parse (argc,argv);
+
+  AllocationRun before;
+  AllocationRun after;
+  AllocationRun *runs[] = { &before, &after };
+  for (uint32_t r = 0; r < 2; r++)
+    {
+      runs[r]->lazy = (r == 1);
+      runs[r]->records = 0;
+      runs[r]->seconds = 0;
+      Run (*runs[r], nodes, neighbors, Seconds (duration));
+    }
+
+  std::cout << "Update records processed: " << after.records << std::endl;
+  std::cout << "Heap allocations per simulated second before: " << before.heapAllocations / duration
+            << " after: " << after.heapAllocations / duration << std::endl;
+  std::cout << "Time per update record before: " << 1e9 * before.seconds / before.records << " ns"
+            << " after: " << 1e9 * after.seconds / after.records << " ns" << std::endl;
+  std::cout << "Resident set growth before: " << before.residentGrowth / 1024 << " KiB"
+            << " after: " << after.residentGrowth / 1024 << " KiB" << std::endl;
+  return 0;
+}
@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Measures the routing table work DreamRoutingProtocol::RouteOutput does
+ * for every locally originated packet while routes keep expiring and
+ * being learned again.  Every route is refreshed once per periodic update
+ * interval, except that with a given probability the route falls silent
+ * for four intervals, so that it expires, is purged together with its
+ * dependents and is learned again later.
+ *
+ * "before" purged the routing table, advertised the removed routes and
+ * scheduled a triggered update from RouteOutput itself; "after" only
+ * resolves the route, and the removal is done by a route expiry timer.
+ * Only the time spent in RouteOutput is counted as per packet cost; the
+ * time spent by the expiry timer is reported separately.
+ *
+ * ./waf --run "dream-route-output-benchmark --routes=1000 --flows=40 --rate=100"
+ */
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/dream-rtable.h"
+
+using namespace ns3;
+
+/// State of one run of the benchmark
+struct RouteOutputRun
+{
+  bool purgeOnOutput; ///< true for the former RouteOutput
+  dream::RoutingTable table; ///< routing table, with the advertisements
+  std::vector<dream::RoutingTableEntry> routes; ///< the routes, as learned
+  Ptr<UniformRandomVariable> rng; ///< refresh losses
+  Ptr<UniformRandomVariable> jitter; ///< triggered update jitter
+  double lossProbability; ///< probability that a route falls silent
+  uint32_t packetsPerBatch; ///< packets sent every millisecond
+  EventId expiryEvent; ///< route expiry timer of the current RouteOutput
+  uint64_t packets; ///< packets sent
+  uint64_t resolved; ///< packets for which a route was found
+  uint64_t triggeredUpdates; ///< triggered update events scheduled
+  double outputSeconds; ///< wall clock time spent in RouteOutput
+  double timerSeconds; ///< wall clock time spent in the expiry timer
+};
+
+/// Stands for SendTriggeredUpdate
+static void
+TriggeredUpdate ()
+{
+}
+
+/**
+ * Advertise the removed routes as the protocol does
+ * \param run the benchmark run
+ * \param removedAddresses the routes removed by Purge
+ */
+static void
+AdvertiseRemoved (RouteOutputRun & run, std::map<Ipv4Address, dream::RoutingTableEntry> & removedAddresses)
+{
+  for (std::map<Ipv4Address, dream::RoutingTableEntry>::iterator i = removedAddresses.begin ();
+       i != removedAddresses.end (); ++i)
+    {
+      i->second.SetEntriesChanged (true);
+      i->second.SetSeqNo (i->second.GetSeqNo () + 1);
+      run.table.AddAdvertisement (i->second);
+    }
+  if (!removedAddresses.empty ())
+    {
+      Simulator::Schedule (MicroSeconds (run.jitter->GetInteger (0, 1000)), &TriggeredUpdate);
+      run.triggeredUpdates++;
+    }
+}
+
+static void ScheduleExpiry (RouteOutputRun * run);
+
+/**
+ * The route expiry timer
+ * \param run the benchmark run
+ */
+static void
+PurgeRoutes (RouteOutputRun * run)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  std::map<Ipv4Address, dream::RoutingTableEntry> removedAddresses;
+  run->table.Purge (removedAddresses);
+  AdvertiseRemoved (*run, removedAddresses);
+  ScheduleExpiry (run);
+  run->timerSeconds += std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+/**
+ * Schedule the route expiry timer for the earliest route expiry
+ * \param run the benchmark run
+ */
+static void
+ScheduleExpiry (RouteOutputRun * run)
+{
+  Time next;
+  if (run->purgeOnOutput || !run->table.GetNextExpiry (next))
+    {
+      return;
+    }
+  Time delay = std::max (next - Simulator::Now (), Seconds (0)) + NanoSeconds (1);
+  if (run->expiryEvent.IsRunning () && Simulator::GetDelayLeft (run->expiryEvent) <= delay)
+    {
+      return;
+    }
+  run->expiryEvent.Cancel ();
+  run->expiryEvent = Simulator::Schedule (delay, &PurgeRoutes, run);
+}
+
+/**
+ * Learn a route again, or let it fall silent
+ * \param run the benchmark run
+ * \param i the index of the route
+ * \param interval the periodic update interval
+ */
+static void
+Refresh (RouteOutputRun * run, uint32_t i, Time interval)
+{
+  dream::RoutingTableEntry rt = run->routes[i];
+  rt.SetLifeTime (Simulator::Now ());
+  if (!run->table.Update (rt))
+    {
+      run->table.AddRoute (rt);
+    }
+  ScheduleExpiry (run);
+  bool silent = run->rng->GetValue () < run->lossProbability;
+  Simulator::Schedule ((silent ? 4 : 1) * interval, &Refresh, run, i, interval);
+}
+
+/**
+ * Send a batch of packets
+ * \param run the benchmark run
+ */
+static void
+SendBatch (RouteOutputRun * run)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t p = 0; p < run->packetsPerBatch; p++)
+    {
+      if (run->purgeOnOutput)
+        {
+          std::map<Ipv4Address, dream::RoutingTableEntry> removedAddresses;
+          run->table.Purge (removedAddresses);
+          AdvertiseRemoved (*run, removedAddresses);
+        }
+      Ipv4Address dst = run->routes[run->packets % run->routes.size ()].GetDestination ();
+      run->resolved += (run->table.ResolveRoute (dst) != 0);
+      run->packets++;
+    }
+  run->outputSeconds += std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  Simulator::Schedule (MilliSeconds (1), &SendBatch, run);
+}
+
+/**
+ * Run the benchmark
+ * \param run the benchmark run, with its options set
+ * \param routes number of routes
+ * \param neighbors number of one-hop neighbours among the routes
+ * \param duration simulated time
+ */
+static void
+Run (RouteOutputRun & run, uint32_t routes, uint32_t neighbors, Time duration)
+{
+  Time interval = Seconds (15);
+  run.table.Setholddowntime (3 * interval);
+  run.rng = CreateObject<UniformRandomVariable> ();
+  run.jitter = CreateObject<UniformRandomVariable> ();
+  // Same losses in both runs
+  run.rng->SetStream (1);
+  run.jitter->SetStream (2);
+  for (uint32_t i = 0; i < routes; i++)
+    {
+      Ipv4Address dst (0x0a000000 + 1 + i);
+      bool neighbor = i < neighbors;
+      Ipv4Address nextHop = neighbor ? dst : Ipv4Address (0x0a000000 + 1 + i % neighbors);
+      run.routes.push_back (dream::RoutingTableEntry (0, dst, 2 * i, Ipv4InterfaceAddress (),
+                                                      neighbor ? 1 : 2 + i % 6, nextHop, Seconds (0)));
+      Simulator::Schedule (Seconds (run.rng->GetValue (0, interval.GetSeconds ())), &Refresh, &run, i, interval);
+    }
+  Simulator::Schedule (interval, &SendBatch, &run);
+  Simulator::Stop (duration);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t routes = 1000;
+  uint32_t neighbors = 50;
+  uint32_t flows = 40;
+  uint32_t rate = 100;
+  double loss = 0.05;
+  double duration = 120;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("routes", "Number of routes in the table", routes);
+  cmd.AddValue ("neighbors", "Number of one-hop neighbours among the routes", neighbors);
+  cmd.AddValue ("flows", "Number of flows originated by the node", flows);
+  cmd.AddValue ("rate", "Packets per second of every flow", rate);
+  cmd.AddValue ("loss", "Probability that a route falls silent until it expires", loss);
+  cmd.AddValue ("duration", "Simulated time, in seconds", duration);
+  cmd.Parse (argc,argv);
+
+  RouteOutputRun before;
+  RouteOutputRun after;
+  RouteOutputRun *runs[] = { &before, &after };
+  for (uint32_t r = 0; r < 2; r++)
+    {
+      runs[r]->purgeOnOutput = (r == 0);
+      runs[r]->lossProbability = loss;
+      runs[r]->packetsPerBatch = std::max (1u, flows * rate / 1000);
+      runs[r]->packets = 0;
+      runs[r]->resolved = 0;
+      runs[r]->triggeredUpdates = 0;
+      runs[r]->outputSeconds = 0;
+      runs[r]->timerSeconds = 0;
+      Run (*runs[r], routes, neighbors, Seconds (duration));
+    }
+
+  std::cout << "Packets sent: " << after.packets << std::endl;
+  std::cout << "Routes resolved before: " << before.resolved << " after: " << after.resolved << std::endl;
+  std::cout << "Triggered updates scheduled before: " << before.triggeredUpdates
+            << " after: " << after.triggeredUpdates << std::endl;
+  std::cout << "Time per RouteOutput before: " << 1e9 * before.outputSeconds / before.packets << " ns" << std::endl;
+  std::cout << "Time per RouteOutput after:  " << 1e9 * after.outputSeconds / after.packets << " ns" << std::endl;
+  std::cout << "Time in the route expiry timer after: " << 1e3 * after.timerSeconds << " ms" << std::endl;
+  return 0;
+}
@@ -65,4 +65,34 @@ DreamHelper::Set (std::string name, const AttributeValue &value)
   m_agentFactory.Set (name, value);
 }
 
+dream::DreamStatistics
+DreamHelper::GetStatistics (NodeContainer nodes)
+{
+  dream::DreamStatistics statistics;
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+    {
+      Ptr<dream::DreamRoutingProtocol> agent = (*i)->GetObject<dream::DreamRoutingProtocol> ();
+      if (agent != 0)
+        {
+          statistics += agent->GetStatistics ();
+        }
+    }
+  return statistics;
+}
+
+void
+DreamHelper::PrintStatistics (NodeContainer nodes, Ptr<OutputStreamWrapper> stream)
+{
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+    {
+      Ptr<dream::DreamRoutingProtocol> agent = (*i)->GetObject<dream::DreamRoutingProtocol> ();
+      if (agent != 0)
+        {
+          *stream->GetStream () << "Node: " << (*i)->GetId () << " ";
+          agent->GetStatistics ().Print (*stream->GetStream ());
+          *stream->GetStream () << std::endl;
+        }
+    }
+}
+
 }
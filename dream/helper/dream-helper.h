@@ -36,6 +36,8 @@
 #include "ns3/node.h"
 #include "ns3/node-container.h"
 #include "ns3/ipv4-routing-helper.h"
+#include "ns3/output-stream-wrapper.h"
+#include "ns3/dream-routing-protocol.h"
 
 namespace ns3 {
 /**
@@ -71,6 +73,20 @@ public:
    */
   void Set (std::string name, const AttributeValue &value);
 
+  /**
+   * \param nodes the nodes to collect the counters from
+   * \returns the sum of the counters of the DREAM agents on the nodes
+   *
+   * Nodes without a DREAM agent are skipped.
+   */
+  static dream::DreamStatistics GetStatistics (NodeContainer nodes);
+  /**
+   * \param nodes the nodes to print the counters of
+   * \param stream the output stream
+   *
+   * Prints the counters of the DREAM agent of each node on its own line.
+   */
+  static void PrintStatistics (NodeContainer nodes, Ptr<OutputStreamWrapper> stream);
 
 private:
   ObjectFactory m_agentFactory; //!< Object factory
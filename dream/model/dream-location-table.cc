@@ -0,0 +1,271 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "dream-location-table.h"
+#include <algorithm>
+#include <cmath>
+#include "ns3/simulator.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+namespace dream {
+
+/// Key of the grid cell with coordinates (cx, cy)
+static inline int64_t
+CellKey (int64_t cx, int64_t cy)
+{
+  return static_cast<int64_t> ((static_cast<uint64_t> (cx) << 32) | static_cast<uint32_t> (cy));
+}
+
+LocationTable::LocationTable ()
+  : m_cellSize (250.0)
+{
+}
+
+int64_t
+LocationTable::GetCell (double x, double y) const
+{
+  int64_t cx = static_cast<int64_t> (std::floor (x / m_cellSize));
+  int64_t cy = static_cast<int64_t> (std::floor (y / m_cellSize));
+  return CellKey (cx, cy);
+}
+
+void
+LocationTable::RemoveFromCell (uint32_t pos)
+{
+  std::unordered_map<int64_t, std::vector<uint32_t> >::iterator i = m_grid.find (m_cell[pos]);
+  NS_ASSERT (i != m_grid.end ());
+  std::vector<uint32_t> & cell = i->second;
+  *std::find (cell.begin (), cell.end (), pos) = cell.back ();
+  cell.pop_back ();
+  if (cell.empty ())
+    {
+      m_grid.erase (i);
+    }
+}
+
+void
+LocationTable::Update (Ipv4Address node, double x, double y, float speed)
+{
+  int64_t cell = GetCell (x, y);
+  std::pair<std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::iterator, bool> result =
+    m_index.insert (std::make_pair (node, m_nodes.size ()));
+  uint32_t pos = result.first->second;
+  if (result.second)
+    {
+      m_nodes.push_back (node);
+      m_x.push_back (x);
+      m_y.push_back (y);
+      m_speed.push_back (speed);
+      m_updated.push_back (Simulator::Now ());
+      m_cell.push_back (cell);
+      m_grid[cell].push_back (pos);
+      return;
+    }
+  m_x[pos] = x;
+  m_y[pos] = y;
+  m_speed[pos] = speed;
+  m_updated[pos] = Simulator::Now ();
+  if (m_cell[pos] != cell)
+    {
+      RemoveFromCell (pos);
+      m_cell[pos] = cell;
+      m_grid[cell].push_back (pos);
+    }
+}
+
+bool
+LocationTable::Lookup (Ipv4Address node, double & x, double & y, float & speed) const
+{
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator i = m_index.find (node);
+  if (i == m_index.end ())
+    {
+      return false;
+    }
+  x = m_x[i->second];
+  y = m_y[i->second];
+  speed = m_speed[i->second];
+  return true;
+}
+
+void
+LocationTable::GetNodesAround (double x, double y, std::vector<Ipv4Address> & nodes) const
+{
+  int64_t cx = static_cast<int64_t> (std::floor (x / m_cellSize));
+  int64_t cy = static_cast<int64_t> (std::floor (y / m_cellSize));
+  for (int64_t i = cx - 1; i <= cx + 1; i++)
+    {
+      for (int64_t j = cy - 1; j <= cy + 1; j++)
+        {
+          std::unordered_map<int64_t, std::vector<uint32_t> >::const_iterator cell = m_grid.find (CellKey (i, j));
+          if (cell == m_grid.end ())
+            {
+              continue;
+            }
+          for (std::vector<uint32_t>::const_iterator pos = cell->second.begin (); pos != cell->second.end (); ++pos)
+            {
+              nodes.push_back (m_nodes[*pos]);
+            }
+        }
+    }
+}
+
+bool
+LocationTable::GetNodesInCone (Ipv4Address self, Ipv4Address dst, std::vector<Ipv4Address> & nodes) const
+{
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator s = m_index.find (self);
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator d = m_index.find (dst);
+  if (s == m_index.end () || d == m_index.end ())
+    {
+      return false;
+    }
+  double sx = m_x[s->second], sy = m_y[s->second];
+  double dx = m_x[d->second], dy = m_y[d->second];
+  double r = m_speed[d->second] * (Simulator::Now () - m_updated[d->second]).GetSeconds ();
+
+  m_candidates.clear ();
+  int64_t cx = static_cast<int64_t> (std::floor (sx / m_cellSize));
+  int64_t cy = static_cast<int64_t> (std::floor (sy / m_cellSize));
+  for (int64_t i = cx - 1; i <= cx + 1; i++)
+    {
+      for (int64_t j = cy - 1; j <= cy + 1; j++)
+        {
+          std::unordered_map<int64_t, std::vector<uint32_t> >::const_iterator cell = m_grid.find (CellKey (i, j));
+          if (cell != m_grid.end ())
+            {
+              m_candidates.insert (m_candidates.end (), cell->second.begin (), cell->second.end ());
+            }
+        }
+    }
+  uint32_t n = m_candidates.size ();
+  m_candidateX.resize (n);
+  m_candidateY.resize (n);
+  m_inCone.resize (n);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      m_candidateX[i] = m_x[m_candidates[i]];
+      m_candidateY[i] = m_y[m_candidates[i]];
+    }
+  SelectInCone (m_candidateX.data (), m_candidateY.data (), n, sx, sy, dx, dy, r, m_inCone.data ());
+  for (uint32_t i = 0; i < n; i++)
+    {
+      if (m_inCone[i] && m_candidates[i] != s->second)
+        {
+          nodes.push_back (m_nodes[m_candidates[i]]);
+        }
+    }
+  return true;
+}
+
+uint32_t
+LocationTable::SelectInCone (const double *x, const double *y, uint32_t n, double sx, double sy,
+                             double dx, double dy, double r, uint8_t *inCone)
+{
+  double ux = dx - sx;
+  double uy = dy - sy;
+  double k = ux * ux + uy * uy - r * r;
+  if (k <= 0)
+    {
+      std::fill (inCone, inCone + n, 1);
+      return n;
+    }
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double px = x[i] - sx;
+      double py = y[i] - sy;
+      double dot = px * ux + py * uy;
+      uint8_t in = (dot >= 0) & (dot * dot >= (px * px + py * py) * k);
+      inCone[i] = in;
+      count += in;
+    }
+  return count;
+}
+
+void
+LocationTable::Clear ()
+{
+  m_index.clear ();
+  m_nodes.clear ();
+  m_x.clear ();
+  m_y.clear ();
+  m_speed.clear ();
+  m_updated.clear ();
+  m_cell.clear ();
+  m_grid.clear ();
+}
+
+void
+LocationTable::Remove (uint32_t pos)
+{
+  RemoveFromCell (pos);
+  m_index.erase (m_nodes[pos]);
+  uint32_t last = m_nodes.size () - 1;
+  if (pos != last)
+    {
+      std::vector<uint32_t> & cell = m_grid[m_cell[last]];
+      *std::find (cell.begin (), cell.end (), last) = pos;
+      m_index[m_nodes[last]] = pos;
+      m_nodes[pos] = m_nodes[last];
+      m_x[pos] = m_x[last];
+      m_y[pos] = m_y[last];
+      m_speed[pos] = m_speed[last];
+      m_updated[pos] = m_updated[last];
+      m_cell[pos] = m_cell[last];
+    }
+  m_nodes.pop_back ();
+  m_x.pop_back ();
+  m_y.pop_back ();
+  m_speed.pop_back ();
+  m_updated.pop_back ();
+  m_cell.pop_back ();
+}
+
+uint32_t
+LocationTable::Purge (Time before)
+{
+  uint32_t removed = 0;
+  uint32_t pos = 0;
+  while (pos < m_nodes.size ())
+    {
+      if (m_updated[pos] < before)
+        {
+          // pos now holds the node that was last, look at it again
+          Remove (pos);
+          removed++;
+        }
+      else
+        {
+          pos++;
+        }
+    }
+  return removed;
+}
+
+void
+LocationTable::SetCellSize (double cellSize)
+{
+  NS_ASSERT (cellSize > 0);
+  m_cellSize = cellSize;
+  m_grid.clear ();
+  for (uint32_t pos = 0; pos < m_nodes.size (); pos++)
+    {
+      m_cell[pos] = GetCell (m_x[pos], m_y[pos]);
+      m_grid[m_cell[pos]].push_back (pos);
+    }
+}
+
+}
+}
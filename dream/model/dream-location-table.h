@@ -0,0 +1,192 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DREAM_LOCATION_TABLE_H
+#define DREAM_LOCATION_TABLE_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+namespace dream {
+
+/**
+ * \ingroup dream
+ * \brief Last known position and speed of every node we have heard from
+ *
+ * Locations are stored as columns (structure of arrays) indexed by node
+ * address, and bucketed into a uniform grid of square cells so that the
+ * nodes near a point are found without looking at the rest of the table.
+ * Updating the location of a node costs O(1). The locations that are not
+ * refreshed are dropped by Purge.
+ */
+class LocationTable
+{
+public:
+  /// c-tor
+  LocationTable ();
+  /**
+   * Insert or update the location of a node
+   * \param node the node address
+   * \param x position of the node in x axis
+   * \param y position of the node in y axis
+   * \param speed speed of the node
+   */
+  void
+  Update (Ipv4Address node, double x, double y, float speed);
+  /**
+   * Lookup the location of a node
+   * \param node the node address
+   * \param x position of the node in x axis
+   * \param y position of the node in y axis
+   * \param speed speed of the node
+   * \return true if the location of the node is known
+   */
+  bool
+  Lookup (Ipv4Address node, double & x, double & y, float & speed) const;
+  /**
+   * Get the nodes in the cell of a point and in the eight cells around it.
+   * This includes every node within one cell size of the point.
+   * \param x position in x axis
+   * \param y position in y axis
+   * \param nodes the addresses of the nodes found are appended to this list
+   */
+  void
+  GetNodesAround (double x, double y, std::vector<Ipv4Address> & nodes) const;
+  /**
+   * Get the nodes around self that lie in the DREAM expected-zone cone
+   * toward dst: the cone from the position of self that is tangent to the
+   * circle of radius speed * age around the last known position of dst.
+   * \param self the node looking for neighbours
+   * \param dst the destination
+   * \param nodes the addresses of the nodes in the cone are appended to this list
+   * \return false if the location of self or dst is not known
+   */
+  bool
+  GetNodesInCone (Ipv4Address self, Ipv4Address dst, std::vector<Ipv4Address> & nodes) const;
+  /**
+   * Mark the points that lie in the cone from (sx, sy) tangent to the
+   * circle of radius r around (dx, dy). A point p is in the cone if
+   * dot (p - s, d - s) >= 0 and dot^2 >= |p - s|^2 * (|d - s|^2 - r^2);
+   * every point is in the cone if s is inside the circle. The loop has no
+   * branches or transcendental calls so the compiler can vectorise it.
+   * \param x positions of the points in x axis
+   * \param y positions of the points in y axis
+   * \param n number of points
+   * \param sx apex of the cone in x axis
+   * \param sy apex of the cone in y axis
+   * \param dx center of the circle in x axis
+   * \param dy center of the circle in y axis
+   * \param r radius of the circle
+   * \param inCone set to 1 for every point in the cone and to 0 otherwise
+   * \return the number of points in the cone
+   */
+  static uint32_t
+  SelectInCone (const double *x, const double *y, uint32_t n, double sx, double sy,
+                double dx, double dy, double r, uint8_t *inCone);
+  /**
+   * Get the number of nodes in the table
+   * \return the number of nodes
+   */
+  uint32_t
+  GetSize () const
+  {
+    return m_nodes.size ();
+  }
+  /// Delete all locations
+  void
+  Clear ();
+  /**
+   * Delete the locations last updated before a time
+   * \param before the time
+   * \return the number of locations deleted
+   */
+  uint32_t
+  Purge (Time before);
+  /**
+   * Set the side of a grid cell. Should be no less than the radio range so
+   * that GetNodesAround covers every neighbour of a node.
+   * \param cellSize the cell size in meters
+   */
+  void
+  SetCellSize (double cellSize);
+  /**
+   * Get the side of a grid cell
+   * \return the cell size in meters
+   */
+  double
+  GetCellSize () const
+  {
+    return m_cellSize;
+  }
+
+private:
+  /**
+   * Get the key of the grid cell containing a point
+   * \param x position in x axis
+   * \param y position in y axis
+   * \return the cell key
+   */
+  int64_t
+  GetCell (double x, double y) const;
+  /**
+   * Remove the node stored at pos from the list of its grid cell
+   * \param pos position of the node in the columns
+   */
+  void
+  RemoveFromCell (uint32_t pos);
+  /**
+   * Delete the node stored at pos. The last node of the columns takes its place.
+   * \param pos position of the node in the columns
+   */
+  void
+  Remove (uint32_t pos);
+
+  /// position of each node in the columns below
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash> m_index;
+  /// node addresses
+  std::vector<Ipv4Address> m_nodes;
+  /// positions in x axis
+  std::vector<double> m_x;
+  /// positions in y axis
+  std::vector<double> m_y;
+  /// speeds
+  std::vector<float> m_speed;
+  /// time of the last location update
+  std::vector<Time> m_updated;
+  /// grid cell of each node
+  std::vector<int64_t> m_cell;
+  /// nodes (as positions in the columns) in each grid cell
+  std::unordered_map<int64_t, std::vector<uint32_t> > m_grid;
+  /// side of a grid cell in meters
+  double m_cellSize;
+  /// positions of the candidates of GetNodesInCone, kept to avoid reallocating them
+  mutable std::vector<uint32_t> m_candidates;
+  /// candidate positions in x axis
+  mutable std::vector<double> m_candidateX;
+  /// candidate positions in y axis
+  mutable std::vector<double> m_candidateY;
+  /// candidates found in the cone
+  mutable std::vector<uint8_t> m_inCone;
+};
+
+}
+}
+
+#endif /* DREAM_LOCATION_TABLE_H */
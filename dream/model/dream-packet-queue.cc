@@ -31,6 +31,7 @@
 #include "dream-packet-queue.h"
 #include <algorithm>
 #include <functional>
+#include <iterator>
 #include "ns3/ipv4-route.h"
 #include "ns3/socket.h"
 #include "ns3/log.h"
@@ -43,89 +44,193 @@ namespace dream {
 uint32_t
 PacketQueue::GetSize ()
 {
-  Purge ();
   return m_queue.size ();
 }
 
 bool
 PacketQueue::Enqueue (QueueEntry & entry)
 {
-  NS_LOG_FUNCTION ("Enqueing packet destined for" << entry.GetIpv4Header ().GetDestination ());
-  Purge ();
-  uint32_t numPacketswithdst;
-  for (std::vector<QueueEntry>::const_iterator i = m_queue.begin (); i
-       != m_queue.end (); ++i)
+  Ipv4Address dst = entry.GetIpv4Header ().GetDestination ();
+  NS_LOG_FUNCTION ("Enqueing packet destined for" << dst);
+  if (m_uids.count (GetKey (entry)))
+    {
+      return Reject (entry, REJECT_DUPLICATE);
+    }
+  uint32_t size = entry.GetPacket ()->GetSize ();
+  if (m_maxBytes != 0 && size > m_maxBytes)
+    {
+      return Reject (entry, REJECT_QUEUE_BYTES);
+    }
+  NS_LOG_DEBUG ("Number of packets with this destination: " << GetCountForPacketsWithDst (dst));
+  /** For Brock Paper comparison*/
+  while (GetCountForPacketsWithDst (dst) >= m_maxLenPerDst)
     {
-      if ((i->GetPacket ()->GetUid () == entry.GetPacket ()->GetUid ())
-          && (i->GetIpv4Header ().GetDestination ()
-              == entry.GetIpv4Header ().GetDestination ()))
+      if (m_policy == QUEUE_DROP_TAIL || m_maxLenPerDst == 0)
         {
-          return false;
+          NS_LOG_DEBUG ("Max packets reached for this destination. Not queuing any further packets");
+          return Reject (entry, REJECT_DESTINATION_FULL);
         }
+      Evict (m_dstQueues[dst].front ());
     }
-  numPacketswithdst = GetCountForPacketsWithDst (entry.GetIpv4Header ().GetDestination ());
-  NS_LOG_DEBUG ("Number of packets with this destination: " << numPacketswithdst);
-  /** For Brock Paper comparison*/
-  if (numPacketswithdst >= m_maxLenPerDst || m_queue.size () >= m_maxLen)
+  while (IsFull (size))
     {
-      NS_LOG_DEBUG ("Max packets reached for this destination. Not queuing any further packets");
-      return false;
+      if (m_policy == QUEUE_DROP_TAIL || m_queue.empty ())
+        {
+          NS_LOG_DEBUG ("Queue full. Not queuing any further packets");
+          return Reject (entry, m_queue.size () >= m_maxLen ? REJECT_QUEUE_FULL : REJECT_QUEUE_BYTES);
+        }
+      Evict (SelectVictim (dst));
+    }
+  std::deque<EntryIterator> & dstQueue = m_dstQueues[dst];
+  entry.SetExpireTime (m_queueTimeout);
+  entry.SetEnqueueTime (Simulator::Now ());
+  // The timeout is the same for every packet, so this normally appends
+  std::list<QueueEntry>::iterator pos = m_queue.end ();
+  while (pos != m_queue.begin () && std::prev (pos)->GetExpireTime () > entry.GetExpireTime ())
+    {
+      --pos;
+    }
+  dstQueue.push_back (m_queue.insert (pos, entry));
+  UpdateLength (dst, dstQueue.size () - 1, dstQueue.size ());
+  m_uids.insert (GetKey (entry));
+  m_bytes += size;
+  ScheduleExpiry ();
+  return true;
+}
+
+bool
+PacketQueue::IsFull (uint32_t size) const
+{
+  return m_queue.size () >= m_maxLen || (m_maxBytes != 0 && m_bytes + size > m_maxBytes);
+}
+
+PacketQueue::EntryIterator
+PacketQueue::SelectVictim (Ipv4Address dst)
+{
+  NS_ASSERT (!m_queue.empty ());
+  if (m_policy != QUEUE_FAIR_SHARE)
+    {
+      return m_queue.begin ();
+    }
+  // The destination with the most packets, the new packet included, gives up its oldest one
+  NS_ASSERT (!m_lengths.empty ());
+  Ipv4Address victim = m_lengths.rbegin ()->second;
+  std::unordered_map<Ipv4Address, std::deque<EntryIterator>, Ipv4AddressHash>::const_iterator d = m_dstQueues.find (dst);
+  if (d != m_dstQueues.end () && d->second.size () + 1 > m_lengths.rbegin ()->first)
+    {
+      victim = dst;
+    }
+  return m_dstQueues[victim].front ();
+}
+
+void
+PacketQueue::SetQueuePolicy (QueuePolicy policy)
+{
+  m_policy = policy;
+  m_lengths.clear ();
+  if (m_policy == QUEUE_FAIR_SHARE)
+    {
+      for (std::unordered_map<Ipv4Address, std::deque<EntryIterator>, Ipv4AddressHash>::const_iterator d = m_dstQueues.begin ();
+           d != m_dstQueues.end (); ++d)
+        {
+          m_lengths.insert (std::make_pair (d->second.size (), d->first));
+        }
+    }
+}
+
+void
+PacketQueue::UpdateLength (Ipv4Address dst, uint32_t oldLen, uint32_t newLen)
+{
+  if (m_policy != QUEUE_FAIR_SHARE)
+    {
+      return;
+    }
+  if (oldLen != 0)
+    {
+      m_lengths.erase (std::make_pair (oldLen, dst));
+    }
+  if (newLen != 0)
+    {
+      m_lengths.insert (std::make_pair (newLen, dst));
+    }
+}
+
+void
+PacketQueue::Evict (EntryIterator i)
+{
+  QueueEntry en = *i;
+  Erase (i);
+  Drop (en, DROP_QUEUE_EVICTED);
+}
+
+void
+PacketQueue::Erase (EntryIterator i)
+{
+  Ipv4Address dst = i->GetIpv4Header ().GetDestination ();
+  std::unordered_map<Ipv4Address, std::deque<EntryIterator>, Ipv4AddressHash>::iterator d = m_dstQueues.find (dst);
+  NS_ASSERT (d != m_dstQueues.end ());
+  if (d->second.front () == i)
+    {
+      d->second.pop_front ();
     }
   else
     {
-      // NS_LOG_DEBUG("Packet size while enqueing "<<entry.GetPacket()->GetSize());
-      entry.SetExpireTime (m_queueTimeout);
-      m_queue.push_back (entry);
-      return true;
+      d->second.erase (std::find (d->second.begin (), d->second.end (), i));
     }
+  UpdateLength (dst, d->second.size () + 1, d->second.size ());
+  if (d->second.empty ())
+    {
+      m_dstQueues.erase (d);
+    }
+  m_uids.erase (GetKey (*i));
+  m_bytes -= i->GetPacket ()->GetSize ();
+  m_queue.erase (i);
 }
 
 void
 PacketQueue::DropPacketWithDst (Ipv4Address dst)
 {
   NS_LOG_FUNCTION ("Dropping packet to " << dst);
-  Purge ();
-  for (std::vector<QueueEntry>::iterator i = m_queue.begin (); i
-       != m_queue.end (); ++i)
+  std::unordered_map<Ipv4Address, std::deque<EntryIterator>, Ipv4AddressHash>::iterator d = m_dstQueues.find (dst);
+  if (d == m_dstQueues.end ())
     {
-      if (i->GetIpv4Header ().GetDestination () == dst)
-        {
-          Drop (*i, "DropPacketWithDst ");
-        }
+      return;
+    }
+  std::deque<EntryIterator> entries;
+  entries.swap (d->second);
+  m_dstQueues.erase (d);
+  UpdateLength (dst, entries.size (), 0);
+  for (std::deque<EntryIterator>::const_iterator i = entries.begin (); i != entries.end (); ++i)
+    {
+      QueueEntry en = **i;
+      m_uids.erase (GetKey (en));
+      m_bytes -= en.GetPacket ()->GetSize ();
+      m_queue.erase (*i);
+      Drop (en, DROP_QUEUE_FLUSHED);
     }
-  auto new_end = std::remove_if (m_queue.begin (), m_queue.end (), [&](const QueueEntry& en)
-                                 { return en.GetIpv4Header ().GetDestination () == dst; });
-  m_queue.erase (new_end, m_queue.end ());
 }
 
 bool
 PacketQueue::Dequeue (Ipv4Address dst, QueueEntry & entry)
 {
   NS_LOG_FUNCTION ("Dequeueing packet destined for" << dst);
-  Purge ();
-  for (std::vector<QueueEntry>::iterator i = m_queue.begin (); i != m_queue.end (); ++i)
+  std::unordered_map<Ipv4Address, std::deque<EntryIterator>, Ipv4AddressHash>::iterator d = m_dstQueues.find (dst);
+  if (d == m_dstQueues.end ())
     {
-      if (i->GetIpv4Header ().GetDestination () == dst)
-        {
-          entry = *i;
-          m_queue.erase (i);
-          return true;
-        }
+      return false;
     }
-  return false;
+  entry = *d->second.front ();
+  Erase (d->second.front ());
+  return true;
 }
 
 bool
 PacketQueue::Find (Ipv4Address dst)
 {
-  for (std::vector<QueueEntry>::const_iterator i = m_queue.begin (); i
-       != m_queue.end (); ++i)
+  if (m_dstQueues.find (dst) != m_dstQueues.end ())
     {
-      if (i->GetIpv4Header ().GetDestination () == dst)
-        {
-          NS_LOG_DEBUG ("Find");
-          return true;
-        }
+      NS_LOG_DEBUG ("Find");
+      return true;
     }
   return false;
 }
@@ -133,61 +238,66 @@ PacketQueue::Find (Ipv4Address dst)
 uint32_t
 PacketQueue::GetCountForPacketsWithDst (Ipv4Address dst)
 {
-  uint32_t count = 0;
-  for (std::vector<QueueEntry>::const_iterator i = m_queue.begin (); i
-       != m_queue.end (); ++i)
+  std::unordered_map<Ipv4Address, std::deque<EntryIterator>, Ipv4AddressHash>::const_iterator d = m_dstQueues.find (dst);
+  return d == m_dstQueues.end () ? 0 : d->second.size ();
+}
+
+void
+PacketQueue::Purge ()
+{
+  // NS_LOG_DEBUG("Purging Queue");
+  while (!m_queue.empty () && !m_queue.front ().GetExpireTime ().IsStrictlyPositive ())
     {
-      if (i->GetIpv4Header ().GetDestination () == dst)
-        {
-          count++;
-        }
+      NS_LOG_DEBUG ("Dropping outdated Packets");
+      QueueEntry en = m_queue.front ();
+      Erase (m_queue.begin ());
+      Drop (en, DROP_QUEUE_TIMEOUT);
     }
-  return count;
 }
 
-/**
- * IsExpired structure
- */
-struct IsExpired
-{
-  /**
-   * \brief Check for expired entry
-   * \param e QueueEntry to check
-   * \return true if expired
-   */
-  bool
-  operator() (QueueEntry const & e) const
-  {
-    // NS_LOG_DEBUG("Expire time for packet in req queue: "<<e.GetExpireTime ());
-    return (e.GetExpireTime () < Seconds (0));
-  }
-};
+void
+PacketQueue::Expire ()
+{
+  Purge ();
+  ScheduleExpiry ();
+}
 
 void
-PacketQueue::Purge ()
+PacketQueue::ScheduleExpiry ()
 {
-  // NS_LOG_DEBUG("Purging Queue");
-  IsExpired pred;
-  for (std::vector<QueueEntry>::iterator i = m_queue.begin (); i
-       != m_queue.end (); ++i)
+  // Dequeued packets leave the event behind; it then only reschedules itself
+  if (m_queue.empty ()
+      || (m_expiryEvent.IsRunning () && Simulator::GetDelayLeft (m_expiryEvent) <= m_queue.front ().GetExpireTime ()))
     {
-      if (pred (*i))
-        {
-          NS_LOG_DEBUG ("Dropping outdated Packets");
-          Drop (*i, "Drop outdated packet ");
-        }
+      return;
     }
-  m_queue.erase (std::remove_if (m_queue.begin (), m_queue.end (), pred),
-                 m_queue.end ());
+  m_expiryEvent.Cancel ();
+  m_expiryEvent = Simulator::Schedule (m_queue.front ().GetExpireTime (), &PacketQueue::Expire, this);
 }
 
 void
-PacketQueue::Drop (QueueEntry en, std::string reason)
+PacketQueue::Drop (QueueEntry const & en, DropReason reason)
 {
-  NS_LOG_LOGIC (reason << en.GetPacket ()->GetUid () << " " << en.GetIpv4Header ().GetDestination ());
+  NS_LOG_LOGIC ("Drop packet " << en.GetPacket ()->GetUid () << " " << en.GetIpv4Header ().GetDestination ()
+                               << " reason " << reason);
   // en.GetErrorCallback () (en.GetPacket (), en.GetIpv4Header (),
   //   Socket::ERROR_NOROUTETOHOST);
-  return;
+  if (!m_dropCallback.IsNull ())
+    {
+      m_dropCallback (en, reason);
+    }
+}
+
+bool
+PacketQueue::Reject (QueueEntry const & en, EnqueueRejectReason reason)
+{
+  NS_LOG_LOGIC ("Reject packet " << en.GetPacket ()->GetUid () << " " << en.GetIpv4Header ().GetDestination ()
+                                 << " reason " << reason);
+  if (!m_rejectCallback.IsNull ())
+    {
+      m_rejectCallback (en, reason);
+    }
+  return false;
 }
 
 }
@@ -32,12 +32,51 @@
 #ifndef DREAM_PACKETQUEUE_H
 #define DREAM_PACKETQUEUE_H
 
-#include <vector>
+#include <deque>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/simulator.h"
 
 namespace ns3 {
 namespace dream {
+/**
+ * \ingroup dream
+ * \brief Reasons for which DREAM drops a data packet
+ */
+enum DropReason
+{
+  DROP_QUEUE_TIMEOUT = 0,   //!< The packet waited longer than the queue timeout for a route
+  DROP_QUEUE_FLUSHED,       //!< The packets queued for the destination were flushed
+  DROP_QUEUE_EVICTED,       //!< The packet was evicted from the queue to make room for a newer one
+  DROP_NO_ROUTE,            //!< There is no route to the destination and the packet is not buffered
+  DROP_INTERFACE_MISMATCH,  //!< The route does not use the output interface the packet is bound to
+  DROP_REASON_COUNT         //!< Number of drop reasons
+};
+/**
+ * \ingroup dream
+ * \brief Reasons for which the packet queue refuses a packet
+ */
+enum EnqueueRejectReason
+{
+  REJECT_DUPLICATE = 0,     //!< The packet is already queued for the destination
+  REJECT_DESTINATION_FULL,  //!< The maximum number of packets is queued for the destination
+  REJECT_QUEUE_FULL,        //!< The maximum number of packets is queued
+  REJECT_QUEUE_BYTES,       //!< The packet does not fit in the maximum number of bytes queued
+  REJECT_REASON_COUNT       //!< Number of reject reasons
+};
+/**
+ * \ingroup dream
+ * \brief What the packet queue does with a packet that does not fit
+ */
+enum QueuePolicy
+{
+  QUEUE_DROP_TAIL = 0,      //!< Refuse the new packet
+  QUEUE_DROP_OLDEST,        //!< Evict the oldest packets of the destination or of the whole queue
+  QUEUE_FAIR_SHARE          //!< Evict the oldest packets of the destination with the most packets queued
+};
 /**
  * \ingroup dream
  * \brief Dream Queue Entry
@@ -64,7 +103,8 @@ public:
       m_header (h),
       m_ucb (ucb),
       m_ecb (ecb),
-      m_expire (Seconds (0))
+      m_expire (Seconds (0)),
+      m_enqueueTime (Seconds (0))
   {
   }
 
@@ -159,6 +199,22 @@ public:
   {
     return m_expire - Simulator::Now ();
   }
+  /**
+   * Set the time the entry was queued
+   * \param t the enqueue time
+   */
+  void SetEnqueueTime (Time t)
+  {
+    m_enqueueTime = t;
+  }
+  /**
+   * Get the time the entry was queued
+   * \returns the enqueue time
+   */
+  Time GetEnqueueTime () const
+  {
+    return m_enqueueTime;
+  }
 
 private:
   /// Data packet
@@ -171,21 +227,45 @@ private:
   ErrorCallback m_ecb;
   /// Expire time for queue entry
   Time m_expire;
+  /// Time the entry was queued
+  Time m_enqueueTime;
 };
 /**
  * \ingroup dream
  * \brief dream Packet queue
  *
  * When a route is not available, the packets are queued. Every node can buffer up to 5 packets per
- * destination. We have implemented a "drop front on full" queue where the first queued packet will be dropped
- * to accommodate newer packets.
+ * destination, and optionally a maximum number of bytes. What happens to a packet that does not fit depends
+ * on the queue policy: drop tail refuses it, drop oldest evicts the oldest packets (of the destination if its
+ * limit is reached, of the queue otherwise) and fair share evicts the oldest packets of the destination with
+ * the most packets queued, counting the new packet.
+ *
+ * Entries are kept in a single list ordered by expire time. Each destination has a FIFO of positions in
+ * that list and a set of (packet UID, destination) pairs rejects duplicates, so no operation scans the queue.
+ * Under fair share the destinations are also kept ordered by their number of packets, so the longest one
+ * is found in logarithmic time.
+ * A single event, scheduled for the earliest expire time, drops expired packets in expire time order.
+ *
+ * The owner is told about every packet the queue drops or refuses through the drop and reject callbacks.
  */
 class PacketQueue
 {
 public:
+  /// Callback invoked for every packet the queue drops
+  typedef Callback<void, QueueEntry const &, DropReason> DropCallback;
+  /// Callback invoked for every packet the queue refuses
+  typedef Callback<void, QueueEntry const &, EnqueueRejectReason> RejectCallback;
   /// Default c-tor
   PacketQueue ()
+    : m_maxBytes (0),
+      m_bytes (0),
+      m_policy (QUEUE_DROP_TAIL)
+  {
+  }
+  /// d-tor, cancels the expiry event
+  ~PacketQueue ()
   {
+    m_expiryEvent.Cancel ();
   }
   /**
    * Push entry in queue, if there is no entry with the same packet and destination address in queue.
@@ -274,23 +354,158 @@ public:
   {
     m_queueTimeout = t;
   }
+  /**
+   * Get maximum number of bytes queued
+   * \returns the maximum number of bytes, 0 if there is no limit
+   */
+  uint32_t GetMaxQueueBytes () const
+  {
+    return m_maxBytes;
+  }
+  /**
+   * Set maximum number of bytes queued
+   * \param bytes the maximum number of bytes, 0 for no limit
+   */
+  void SetMaxQueueBytes (uint32_t bytes)
+  {
+    m_maxBytes = bytes;
+  }
+  /**
+   * Get the queue policy
+   * \returns the queue policy
+   */
+  QueuePolicy GetQueuePolicy () const
+  {
+    return m_policy;
+  }
+  /**
+   * Set the queue policy
+   * \param policy the queue policy
+   */
+  void SetQueuePolicy (QueuePolicy policy);
+  /**
+   * Get the number of bytes queued
+   * \returns the number of bytes
+   */
+  uint32_t GetBytes () const
+  {
+    return m_bytes;
+  }
+  /**
+   * Set the callback invoked for every packet the queue drops, after it has left the queue
+   * \param cb the drop callback
+   */
+  void SetDropCallback (DropCallback cb)
+  {
+    m_dropCallback = cb;
+  }
+  /**
+   * Set the callback invoked for every packet Enqueue refuses
+   * \param cb the reject callback
+   */
+  void SetRejectCallback (RejectCallback cb)
+  {
+    m_rejectCallback = cb;
+  }
 
 private:
-  std::vector<QueueEntry> m_queue; ///< the queue
+  /// Position of an entry in the queue
+  typedef std::list<QueueEntry>::iterator EntryIterator;
+  /// Hash of a (packet UID, destination) pair
+  struct EntryKeyHash
+  {
+    /**
+     * \param key the pair
+     * \return the hash
+     */
+    size_t operator() (std::pair<uint64_t, uint32_t> const & key) const
+    {
+      return std::hash<uint64_t> () (key.first ^ (static_cast<uint64_t> (key.second) << 32));
+    }
+  };
+  /**
+   * Get the key of an entry in the UID set
+   * \param entry the queue entry
+   * \return the key
+   */
+  static std::pair<uint64_t, uint32_t> GetKey (QueueEntry const & entry)
+  {
+    return std::make_pair (entry.GetPacket ()->GetUid (), entry.GetIpv4Header ().GetDestination ().Get ());
+  }
+  /**
+   * Remove an entry from the queue, its destination FIFO and the UID set
+   * \param i the entry
+   */
+  void Erase (EntryIterator i);
+  /**
+   * Remove an entry to make room for a newer packet and notify the drop
+   * \param i the entry
+   */
+  void Evict (EntryIterator i);
+  /**
+   * Whether a packet does not fit in the queue limits
+   * \param size the size of the packet
+   * \returns true if the packet count or byte limit would be exceeded
+   */
+  bool IsFull (uint32_t size) const;
+  /**
+   * Select the entry to evict for a packet that does not fit
+   * \param dst the destination of the new packet
+   * \returns the entry to evict
+   */
+  EntryIterator SelectVictim (Ipv4Address dst);
+  /**
+   * Move a destination to its new place in m_lengths
+   * \param dst the destination
+   * \param oldLen the number of packets it had, 0 if it was not queued
+   * \param newLen the number of packets it has now, 0 if it is gone
+   */
+  void UpdateLength (Ipv4Address dst, uint32_t oldLen, uint32_t newLen);
+
+  std::list<QueueEntry> m_queue; ///< the queue, in expire time order
+  /// entries of each destination, oldest first
+  std::unordered_map<Ipv4Address, std::deque<EntryIterator>, Ipv4AddressHash> m_dstQueues;
+  /// (number of packets, destination) of every queued destination, the longest last. Only kept under fair share.
+  std::set<std::pair<uint32_t, Ipv4Address> > m_lengths;
+  /// (packet UID, destination) of every entry
+  std::unordered_set<std::pair<uint64_t, uint32_t>, EntryKeyHash> m_uids;
   /// Remove all expired entries
   void Purge ();
+  /// Remove all expired entries and schedule the expiry event for the next one
+  void Expire ();
+  /// Schedule the expiry event for the earliest expire time if it is not running
+  void ScheduleExpiry ();
+  /// Event dropping the packets that have expired
+  EventId m_expiryEvent;
   /**
-   * Notify that the packet is dropped from queue due to timeout
+   * Notify that the packet is dropped from queue
    * \param en the queue entry
    * \param reason the reason for the packet drop
    */
-  void Drop (QueueEntry en, std::string reason);
+  void Drop (QueueEntry const & en, DropReason reason);
+  /**
+   * Notify that Enqueue refused the packet
+   * \param en the queue entry
+   * \param reason the reason for the refusal
+   * \return false
+   */
+  bool Reject (QueueEntry const & en, EnqueueRejectReason reason);
+  /// Drop callback
+  DropCallback m_dropCallback;
+  /// Reject callback
+  RejectCallback m_rejectCallback;
   /// The maximum number of packets that we allow a routing protocol to buffer.
   uint32_t m_maxLen;
   /// The maximum number of packets that we allow per destination to buffer.
   uint32_t m_maxLenPerDst;
   /// The maximum period of time that a routing protocol is allowed to buffer a packet for, seconds.
   Time m_queueTimeout;
+  /// The maximum number of bytes that we allow to buffer, 0 for no limit.
+  uint32_t m_maxBytes;
+  /// The number of bytes buffered.
+  uint32_t m_bytes;
+  /// What to do with a packet that does not fit.
+  QueuePolicy m_policy;
 };
 }
 }
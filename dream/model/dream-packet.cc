@@ -31,6 +31,8 @@
 #include "dream-packet.h"
 #include "ns3/address-utils.h"
 #include "ns3/packet.h"
+#include <algorithm>
+#include <cstring>
 
 
 namespace ns3 {
@@ -38,13 +40,13 @@ namespace dream {
 
 NS_OBJECT_ENSURE_REGISTERED (DreamHeader);
 
-DreamHeader::DreamHeader (Ipv4Address dst, uint32_t hopCount, uint32_t dstSeqNo,uint32_t x, uint32_t y,float v)
+const uint32_t DreamHeader::RECORD_SIZE;
+const uint32_t DreamHeader::MAX_HOP_COUNT;
+
+DreamHeader::DreamHeader (Ipv4Address dst, uint32_t hopCount, uint32_t dstSeqNo)
   : m_dst (dst),
     m_hopCount (hopCount),
-    m_dstSeqNo (dstSeqNo),
-    m_x(x),
-    m_y(y),
-    m_speed(v)
+    m_dstSeqNo (dstSeqNo)
 {
 }
 
@@ -71,19 +73,15 @@ DreamHeader::GetInstanceTypeId () const
 uint32_t
 DreamHeader::GetSerializedSize () const
 {
-  return 12;
+  return RECORD_SIZE;
 }
 
 void
 DreamHeader::Serialize (Buffer::Iterator i) const
 {
   WriteTo (i, m_dst);
-  WriteTo (i, m_src);
-  i.WriteHtonU32 (m_hopCount);
   i.WriteHtonU32 (m_dstSeqNo);
-  i.WriteHtonU32 (m_x);
-  i.WriteHtonU32 (m_y);
-
+  i.WriteU8 (std::min (m_hopCount, MAX_HOP_COUNT));
 }
 
 uint32_t
@@ -92,11 +90,8 @@ DreamHeader::Deserialize (Buffer::Iterator start)
   Buffer::Iterator i = start;
 
   ReadFrom (i, m_dst);
-  ReadFrom (i, m_src);
-  m_hopCount = i.ReadNtohU32 ();
   m_dstSeqNo = i.ReadNtohU32 ();
-  m_x=i.ReadNtohU32 ();
-  m_y=i.ReadNtohU32 ();
+  m_hopCount = i.ReadU8 ();
 
   uint32_t dist = i.GetDistanceFrom (start);
   NS_ASSERT (dist == GetSerializedSize ());
@@ -107,11 +102,110 @@ void
 DreamHeader::Print (std::ostream &os) const
 {
   os << "DestinationIpv4: " << m_dst
-    << "SourceIpv4: " << m_src
      << " Hopcount: " << m_hopCount
-     << " SequenceNumber: " << m_dstSeqNo
+     << " SequenceNumber: " << m_dstSeqNo;
+}
+
+NS_OBJECT_ENSURE_REGISTERED (DreamUpdateHeader);
+
+const uint8_t DreamUpdateHeader::VERSION;
+const uint32_t DreamUpdateHeader::SENDER_BLOCK_SIZE;
+const uint32_t DreamUpdateHeader::MAX_RECORDS;
+
+DreamUpdateHeader::DreamUpdateHeader (Ipv4Address src, uint32_t x, uint32_t y, float speed)
+  : m_version (VERSION),
+    m_src (src),
+    m_x (x),
+    m_y (y),
+    m_speed (speed)
+{
+}
+
+DreamUpdateHeader::~DreamUpdateHeader ()
+{
+}
+
+TypeId
+DreamUpdateHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::dream::DreamUpdateHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("Dream")
+    .AddConstructor<DreamUpdateHeader> ();
+  return tid;
+}
+
+TypeId
+DreamUpdateHeader::GetInstanceTypeId () const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+DreamUpdateHeader::GetSerializedSize () const
+{
+  return SENDER_BLOCK_SIZE + m_records.size () * DreamHeader::RECORD_SIZE;
+}
+
+void
+DreamUpdateHeader::Serialize (Buffer::Iterator i) const
+{
+  uint32_t speed;
+  std::memcpy (&speed, &m_speed, sizeof (speed));
+  i.WriteU8 (m_version);
+  i.WriteHtonU16 (m_records.size ());
+  WriteTo (i, m_src);
+  i.WriteHtonU32 (m_x);
+  i.WriteHtonU32 (m_y);
+  i.WriteHtonU32 (speed);
+  for (std::vector<DreamHeader>::const_iterator r = m_records.begin (); r != m_records.end (); ++r)
+    {
+      WriteTo (i, r->GetDst ());
+      i.WriteHtonU32 (r->GetDstSeqno ());
+      i.WriteU8 (std::min (r->GetHopCount (), DreamHeader::MAX_HOP_COUNT));
+    }
+}
+
+uint32_t
+DreamUpdateHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+
+  m_version = i.ReadU8 ();
+  uint16_t count = i.ReadNtohU16 ();
+  ReadFrom (i, m_src);
+  m_x = i.ReadNtohU32 ();
+  m_y = i.ReadNtohU32 ();
+  uint32_t speed = i.ReadNtohU32 ();
+  std::memcpy (&m_speed, &speed, sizeof (m_speed));
+  m_records.clear ();
+  if (m_version == VERSION)
+    {
+      m_records.resize (count);
+      for (std::vector<DreamHeader>::iterator r = m_records.begin (); r != m_records.end (); ++r)
+        {
+          Ipv4Address dst;
+          ReadFrom (i, dst);
+          r->SetDst (dst);
+          r->SetDstSeqno (i.ReadNtohU32 ());
+          r->SetHopCount (i.ReadU8 ());
+        }
+    }
+
+  uint32_t dist = i.GetDistanceFrom (start);
+  NS_ASSERT (dist == GetSerializedSize ());
+  return dist;
+}
+
+void
+DreamUpdateHeader::Print (std::ostream &os) const
+{
+  os << "Version: " << (uint32_t) m_version
+     << " SourceIpv4: " << m_src
      << " PositionX: " << m_x
-     << " PositionY: " << m_y;
+     << " PositionY: " << m_y
+     << " Speed: " << m_speed
+     << " Records: " << m_records.size ();
 }
 }
 }
@@ -33,14 +33,34 @@
 #define DREAM_PACKET_H
 
 #include <iostream>
+#include <vector>
 #include "ns3/header.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/nstime.h"
+#include "ns3/assert.h"
 
 namespace ns3 {
 namespace dream {
 
 
+/**
+ * \ingroup dream
+ * \brief One (destination, sequence number, hop count) record of a DREAM update
+ *
+ * Records are carried in a DreamUpdateHeader, which writes them in a
+ * single pass.  On the wire a record is
+  \verbatim
+  0                   1                   2                   3
+  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |                     Destination Address                       |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |                  Destination Sequence Number                  |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |   Hop Count   |
+  +-+-+-+-+-+-+-+-+
+  \endverbatim
+ */
 class DreamHeader : public Header
 {
 public:
@@ -50,12 +70,8 @@ public:
    * \param dst destination IP address
    * \param hopcount hop count
    * \param dstSeqNo destination sequence number
-   * \param src Source IP Address
-   * \param x   Position of node in x axis
-   * \param y   Position of node in y axis
-   * \param speed   Speed of source
    */
-  DreamHeader (Ipv4Address dst = Ipv4Address (), uint32_t hopcount = 0, uint32_t dstSeqNo = 0,uint32_t x=0,uint32_t y=0,float speed=0.0);
+  DreamHeader (Ipv4Address dst = Ipv4Address (), uint32_t hopcount = 0, uint32_t dstSeqNo = 0);
   virtual ~DreamHeader ();
   /**
    * \brief Get the type ID.
@@ -68,6 +84,11 @@ public:
   virtual uint32_t Deserialize (Buffer::Iterator start);
   virtual void Print (std::ostream &os) const;
 
+  /// Size of a record on the wire
+  static const uint32_t RECORD_SIZE = 9;
+  /// Largest hop count that fits in a record
+  static const uint32_t MAX_HOP_COUNT = 0xff;
+
   /**
    * Set destination address
    * \param destination the destination IPv4 address
@@ -86,17 +107,6 @@ public:
   {
     return m_dst;
   }
-  void
-  SetSrc (Ipv4Address destination)
-  {
-    m_src = destination;
-  }
-  
-  Ipv4Address
-  GetSrc () const
-  {
-    return m_src;
-  }
   /**
    * Set hop count
    * \param hopCount the hop count
@@ -133,46 +143,195 @@ public:
   {
     return m_dstSeqNo;
   }
+private:
+  Ipv4Address m_dst; ///< Destination IP Address
+  uint32_t m_hopCount; ///< Number of Hops
+  uint32_t m_dstSeqNo; ///< Destination Sequence Number
+};
+static inline std::ostream & operator<< (std::ostream& os, const DreamHeader & packet)
+{
+  packet.Print (os);
+  return os;
+}
+
+/**
+ * \ingroup dream
+ * \brief A DREAM update: the location of the sender followed by its route records
+ *
+ * The sender block is written once per packet and is followed by
+ * GetNumRecords () DreamHeader records of DreamHeader::RECORD_SIZE bytes.
+  \verbatim
+  0                   1                   2                   3
+  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |    Version    |       Number of Records       |   Source ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+      ... Address                                 |  Position X ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+      ...                                         |  Position Y ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+      ...                                         |   Speed ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+      ...                                         |   Records ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
+ */
+class DreamUpdateHeader : public Header
+{
+public:
+  /**
+   * Constructor
+   *
+   * \param src Source IP Address
+   * \param x   Position of node in x axis
+   * \param y   Position of node in y axis
+   * \param speed   Speed of source
+   */
+  DreamUpdateHeader (Ipv4Address src = Ipv4Address (), uint32_t x = 0, uint32_t y = 0, float speed = 0.0);
+  virtual ~DreamUpdateHeader ();
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize () const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+
+  /// Version of the update format written by this implementation
+  static const uint8_t VERSION = 1;
+  /// Size of the sender block on the wire
+  static const uint32_t SENDER_BLOCK_SIZE = 19;
+  /// Largest number of records in an update
+  static const uint32_t MAX_RECORDS = 0xffff;
+
+  /**
+   * Get the version of the update format. Records of an update with an
+   * unknown version are not deserialized.
+   * \returns the version
+   */
+  uint8_t
+  GetVersion () const
+  {
+    return m_version;
+  }
+  /**
+   * Set source address
+   * \param src the source IPv4 address
+   */
+  void
+  SetSrc (Ipv4Address src)
+  {
+    m_src = src;
+  }
+  /**
+   * Get source address
+   * \returns the source IPv4 address
+   */
+  Ipv4Address
+  GetSrc () const
+  {
+    return m_src;
+  }
+  /**
+   * Set position of the source in x axis
+   * \param x the position
+   */
+  void
+  SetX (uint32_t x)
+  {
+    m_x = x;
+  }
+  /**
+   * Get position of the source in x axis
+   * \returns the position
+   */
   uint32_t
-  GetX()
+  GetX () const
   {
     return m_x;
   }
-  void 
-  SetX(uint32_t nx)
+  /**
+   * Set position of the source in y axis
+   * \param y the position
+   */
+  void
+  SetY (uint32_t y)
   {
-    m_x=nx;
+    m_y = y;
   }
+  /**
+   * Get position of the source in y axis
+   * \returns the position
+   */
   uint32_t
-  GetY()
+  GetY () const
   {
     return m_y;
   }
-  void 
-  SetY(uint32_t ny)
+  /**
+   * Set speed of the source
+   * \param speed the speed
+   */
+  void
+  SetSpeed (float speed)
   {
-    m_y=ny;
+    m_speed = speed;
   }
+  /**
+   * Get speed of the source
+   * \returns the speed
+   */
   float
-  GetSpeed()
+  GetSpeed () const
   {
     return m_speed;
   }
-  void 
-  SetSpeed(float v)
+  /**
+   * Append a record to the update
+   * \param record the record
+   */
+  void
+  AddRecord (const DreamHeader & record)
+  {
+    NS_ASSERT (m_records.size () < MAX_RECORDS);
+    m_records.push_back (record);
+  }
+  /**
+   * Get the records of the update
+   * \returns the records
+   */
+  const std::vector<DreamHeader> &
+  GetRecords () const
   {
-    m_speed=v;
+    return m_records;
+  }
+  /**
+   * Get the number of records
+   * \returns the number of records
+   */
+  uint32_t
+  GetNumRecords () const
+  {
+    return m_records.size ();
+  }
+  /// Delete all records
+  void
+  ClearRecords ()
+  {
+    m_records.clear ();
   }
 private:
+  uint8_t m_version; ///< Version of the update format
   Ipv4Address m_src; ///< Source IP Address
-  Ipv4Address m_dst; ///< Destination IP Address
-  uint32_t m_hopCount; ///< Number of Hops
-  uint32_t m_dstSeqNo; ///< Destination Sequence Number
-  uint32_t m_x;
-  uint32_t m_y;
-  float m_speed;
+  uint32_t m_x; ///< Position of the source in x axis
+  uint32_t m_y; ///< Position of the source in y axis
+  float m_speed; ///< Speed of the source
+  std::vector<DreamHeader> m_records; ///< Route records
 };
-static inline std::ostream & operator<< (std::ostream& os, const DreamHeader & packet)
+static inline std::ostream & operator<< (std::ostream& os, const DreamUpdateHeader & packet)
 {
   packet.Print (os);
   return os;
@@ -37,8 +37,9 @@
 #include "ns3/udp-socket-factory.h"
 #include "ns3/boolean.h"
 #include "ns3/double.h"
+#include "ns3/enum.h"
 #include "ns3/uinteger.h"
-#include <ns3/mobility-model.h>
+#include <algorithm>
 
 namespace ns3 {
 
@@ -51,6 +52,8 @@ NS_OBJECT_ENSURE_REGISTERED (DreamRoutingProtocol);
 /// UDP Port for dream control traffic
 const uint32_t DreamRoutingProtocol::DREAM_PORT = 269;
 
+const uint32_t DreamRoutingProtocol::FORWARDING_CACHE_SIZE = 64;
+
 /// Tag used by dream implementation
 struct DeferredRouteOutputTag : public Tag
 {
@@ -114,6 +117,17 @@ struct DeferredRouteOutputTag : public Tag
   }
 };
 
+/**
+ * Whether a route goes out in the periodic updates
+ * \param rt the route
+ * \return true for the valid routes other than loopback
+ */
+static bool
+IsAdvertised (RoutingTableEntry const & rt)
+{
+  return rt.GetFlag () == VALID && rt.GetDestination () != Ipv4Address ("127.0.0.1");
+}
+
 TypeId
 DreamRoutingProtocol::GetTypeId (void)
 {
@@ -138,6 +152,19 @@ DreamRoutingProtocol::GetTypeId (void)
                    UintegerValue (5),
                    MakeUintegerAccessor (&DreamRoutingProtocol::m_maxQueuedPacketsPerDst),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxQueueBytes", "Maximum number of bytes that we allow a routing protocol to buffer, "
+                   "0 for no limit.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DreamRoutingProtocol::m_maxQueueBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("QueuePolicy", "What the queue does with a packet that exceeds the packet, per destination "
+                   "or byte limits: refuse it, evict the oldest packets, or evict the oldest packets of the "
+                   "destination with the most packets queued.",
+                   EnumValue (QUEUE_DROP_TAIL),
+                   MakeEnumAccessor (&DreamRoutingProtocol::m_queuePolicy),
+                   MakeEnumChecker (QUEUE_DROP_TAIL, "DropTail",
+                                    QUEUE_DROP_OLDEST, "DropOldest",
+                                    QUEUE_FAIR_SHARE, "FairShare"))
     .AddAttribute ("MaxQueueTime","Maximum time packets can be queued (in seconds)",
                    TimeValue (Seconds (30)),
                    MakeTimeAccessor (&DreamRoutingProtocol::m_maxQueueTime),
@@ -168,10 +195,110 @@ DreamRoutingProtocol::GetTypeId (void)
     .AddAttribute ("RouteAggregationTime","Time to aggregate updates before sending them out (in seconds)",
                    TimeValue (Seconds (1)),
                    MakeTimeAccessor (&DreamRoutingProtocol::m_routeAggregationTime),
-                   MakeTimeChecker ());
+                   MakeTimeChecker ())
+    .AddAttribute ("MinTriggeredUpdateInterval","Minimum time between two triggered updates. Changes made "
+                   "in the meantime are merged into the next triggered update.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&DreamRoutingProtocol::m_minTriggeredUpdateInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("EnableIncrementalDump","Enables incremental periodic updates, which only carry the routes "
+                   "changed since the previous periodic update, between full dumps of the routing table",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DreamRoutingProtocol::EnableIncrementalDump),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FullDumpPeriod","Number of periodic updates between full dumps of the routing table "
+                   "if incremental dumps are enabled",
+                   UintegerValue (5),
+                   MakeUintegerAccessor (&DreamRoutingProtocol::m_fullDumpPeriod),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("EnableBackupNextHops","Keeps ranked backup next hops per destination, learned from the "
+                   "updates of other neighbours that advertise as good a metric, and moves a route to the "
+                   "best one at once when its next hop goes away",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DreamRoutingProtocol::EnableBackupNextHops),
+                   MakeBooleanChecker ())
+    .AddAttribute ("EnableGeographicNextHop","Among the neighbours that advertise a route to a destination "
+                   "with the same sequence number and metric, forwards through one in the expected-zone cone "
+                   "toward the destination, the one closest to its last known location first",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DreamRoutingProtocol::EnableGeographicNextHop),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LocationCellSize","Side of the grid cells the node locations are kept in (in meters). "
+                   "Geographic next hops are looked for in the cell of the node and the eight around it, so "
+                   "it should be no less than the radio range.",
+                   DoubleValue (250),
+                   MakeDoubleAccessor (&DreamRoutingProtocol::m_locationCellSize),
+                   MakeDoubleChecker<double> (1))
+    .AddTraceSource ("Drop", "A data packet is dropped.",
+                     MakeTraceSourceAccessor (&DreamRoutingProtocol::m_dropTrace),
+                     "ns3::dream::DreamRoutingProtocol::DropTracedCallback")
+    .AddTraceSource ("EnqueueReject", "The queue refuses to buffer a data packet.",
+                     MakeTraceSourceAccessor (&DreamRoutingProtocol::m_enqueueRejectTrace),
+                     "ns3::dream::DreamRoutingProtocol::EnqueueRejectTracedCallback")
+    .AddTraceSource ("QueueOccupancy", "Number of data packets buffered until a route is found.",
+                     MakeTraceSourceAccessor (&DreamRoutingProtocol::m_queueOccupancy),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("QueueSojourn", "A buffered data packet leaves the queue to be sent.",
+                     MakeTraceSourceAccessor (&DreamRoutingProtocol::m_queueSojournTrace),
+                     "ns3::dream::DreamRoutingProtocol::SojournTracedCallback");
   return tid;
 }
 
+DreamStatistics::DreamStatistics ()
+  : enqueued (0),
+    dequeued (0),
+    maxOccupancy (0),
+    totalSojourn (Seconds (0)),
+    maxSojourn (Seconds (0)),
+    failovers (0),
+    malformedUpdates (0)
+{
+  std::fill (drops, drops + DROP_REASON_COUNT, 0);
+  std::fill (rejects, rejects + REJECT_REASON_COUNT, 0);
+}
+
+DreamStatistics &
+DreamStatistics::operator+= (DreamStatistics const & o)
+{
+  for (uint32_t i = 0; i < DROP_REASON_COUNT; i++)
+    {
+      drops[i] += o.drops[i];
+    }
+  for (uint32_t i = 0; i < REJECT_REASON_COUNT; i++)
+    {
+      rejects[i] += o.rejects[i];
+    }
+  enqueued += o.enqueued;
+  dequeued += o.dequeued;
+  maxOccupancy = std::max (maxOccupancy, o.maxOccupancy);
+  totalSojourn += o.totalSojourn;
+  maxSojourn = std::max (maxSojourn, o.maxSojourn);
+  failovers += o.failovers;
+  malformedUpdates += o.malformedUpdates;
+  return *this;
+}
+
+void
+DreamStatistics::Print (std::ostream & os) const
+{
+  os << "DropTimeout=" << drops[DROP_QUEUE_TIMEOUT]
+     << " DropFlushed=" << drops[DROP_QUEUE_FLUSHED]
+     << " DropEvicted=" << drops[DROP_QUEUE_EVICTED]
+     << " DropNoRoute=" << drops[DROP_NO_ROUTE]
+     << " DropInterfaceMismatch=" << drops[DROP_INTERFACE_MISMATCH]
+     << " RejectDuplicate=" << rejects[REJECT_DUPLICATE]
+     << " RejectDestinationFull=" << rejects[REJECT_DESTINATION_FULL]
+     << " RejectQueueFull=" << rejects[REJECT_QUEUE_FULL]
+     << " RejectQueueBytes=" << rejects[REJECT_QUEUE_BYTES]
+     << " Enqueued=" << enqueued
+     << " Dequeued=" << dequeued
+     << " MaxOccupancy=" << maxOccupancy
+     << " MeanSojourn=" << (dequeued ? totalSojourn.GetSeconds () / dequeued : 0) << "s"
+     << " MaxSojourn=" << maxSojourn.GetSeconds () << "s"
+     << " Failovers=" << failovers
+     << " MalformedUpdates=" << malformedUpdates;
+}
+
 void
 DreamRoutingProtocol::SetEnableBufferFlag (bool f)
 {
@@ -211,11 +338,30 @@ DreamRoutingProtocol::AssignStreams (int64_t stream)
   return 1;
 }
 
+const DreamStatistics &
+DreamRoutingProtocol::GetStatistics () const
+{
+  return m_statistics;
+}
+
+void
+DreamRoutingProtocol::ResetStatistics ()
+{
+  m_statistics = DreamStatistics ();
+  m_statistics.maxOccupancy = m_queueOccupancy;
+}
+
 DreamRoutingProtocol::DreamRoutingProtocol ()
-  : m_routingTable (),
-    m_advRoutingTable (),
+  : m_forwardingCache (FORWARDING_CACHE_SIZE),
+    m_addressGeneration (0),
+    m_routingTable (),
     m_queue (),
-    m_periodicUpdateTimer (Timer::CANCEL_ON_DESTROY)
+    m_queueOccupancy (0),
+    m_periodicUpdateTimer (Timer::CANCEL_ON_DESTROY),
+    m_periodicUpdateCount (0),
+    m_triggeredExpireTimer (Timer::CANCEL_ON_DESTROY),
+    m_lastTriggeredUpdate (Time::Min ()),
+    m_routeExpiryTimer (Timer::CANCEL_ON_DESTROY)
 {
   m_uniformRandomVariable = CreateObject<UniformRandomVariable> ();
 }
@@ -228,12 +374,15 @@ void
 DreamRoutingProtocol::DoDispose ()
 {
   m_ipv4 = 0;
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::iterator iter = m_socketAddresses.begin (); iter
+  m_mobility = 0;
+  for (std::map<Ptr<Socket>, SocketContext>::iterator iter = m_socketAddresses.begin (); iter
        != m_socketAddresses.end (); iter++)
     {
       iter->first->Close ();
     }
   m_socketAddresses.clear ();
+  UpdateLocalAddresses ();
+  m_forwardingCache.clear ();
   Ipv4RoutingProtocol::DoDispose ();
 }
 
@@ -255,11 +404,17 @@ DreamRoutingProtocol::Start ()
   m_queue.SetMaxPacketsPerDst (m_maxQueuedPacketsPerDst);
   m_queue.SetMaxQueueLen (m_maxQueueLen);
   m_queue.SetQueueTimeout (m_maxQueueTime);
+  m_queue.SetMaxQueueBytes (m_maxQueueBytes);
+  m_queue.SetQueuePolicy (m_queuePolicy);
+  m_queue.SetDropCallback (MakeCallback (&DreamRoutingProtocol::QueueDrop,this));
+  m_queue.SetRejectCallback (MakeCallback (&DreamRoutingProtocol::QueueReject,this));
   m_routingTable.Setholddowntime (Time (Holdtimes * m_periodicUpdateInterval));
-  m_advRoutingTable.Setholddowntime (Time (Holdtimes * m_periodicUpdateInterval));
+  m_routingTable.GetLocationTable ().SetCellSize (m_locationCellSize);
   m_scb = MakeCallback (&DreamRoutingProtocol::Send,this);
   m_ecb = MakeCallback (&DreamRoutingProtocol::Drop,this);
   m_periodicUpdateTimer.SetFunction (&DreamRoutingProtocol::SendPeriodicUpdate,this);
+  m_routeExpiryTimer.SetFunction (&DreamRoutingProtocol::PurgeRoutes,this);
+  m_triggeredExpireTimer.SetFunction (&DreamRoutingProtocol::SendTriggeredUpdate,this);
   m_periodicUpdateTimer.Schedule (MicroSeconds (m_uniformRandomVariable->GetInteger (0,1000)));
 }
 
@@ -282,65 +437,26 @@ DreamRoutingProtocol::RouteOutput (Ptr<Packet> p,
       Ptr<Ipv4Route> route;
       return route;
     }
-  std::map<Ipv4Address, RoutingTableEntry> removedAddresses;
   sockerr = Socket::ERROR_NOTERROR;
   Ptr<Ipv4Route> route;
   Ipv4Address dst = header.GetDestination ();
   NS_LOG_DEBUG ("Packet Size: " << p->GetSize ()
                                 << ", Packet id: " << p->GetUid () << ", Destination address in Packet: " << dst);
-  RoutingTableEntry rt;
-  m_routingTable.Purge (removedAddresses);
-  for (std::map<Ipv4Address, RoutingTableEntry>::iterator rmItr = removedAddresses.begin ();
-       rmItr != removedAddresses.end (); ++rmItr)
+  // Expired routes are removed by the route expiry timer
+  route = m_routingTable.ResolveRoute (dst);
+  if (route != 0)
     {
-      rmItr->second.SetEntriesChanged (true);
-      rmItr->second.SetSeqNo (rmItr->second.GetSeqNo () + 1);
-      m_advRoutingTable.AddRoute (rmItr->second);
-    }
-  if (!removedAddresses.empty ())
-    {
-      Simulator::Schedule (MicroSeconds (m_uniformRandomVariable->GetInteger (0,1000)),&DreamRoutingProtocol::SendTriggeredUpdate,this);
-    }
-  if (m_routingTable.LookupRoute (dst,rt))
-    {
-      if (EnableBuffering)
-        {
-          LookForQueuedPackets ();
-        }
-      if (rt.GetHop () == 1)
-        {
-          route = rt.GetRoute ();
-          NS_ASSERT (route != 0);
-          NS_LOG_DEBUG ("A route exists from " << route->GetSource ()
-                                               << " to neighboring destination "
-                                               << route->GetDestination ());
-          if (oif != 0 && route->GetOutputDevice () != oif)
-            {
-              NS_LOG_DEBUG ("Output device doesn't match. Dropped.");
-              sockerr = Socket::ERROR_NOROUTETOHOST;
-              return Ptr<Ipv4Route> ();
-            }
-          return route;
-        }
-      else
+      NS_LOG_DEBUG ("A route exists from " << route->GetSource ()
+                                           << " to destination " << dst << " via "
+                                           << route->GetGateway ());
+      if (oif != 0 && route->GetOutputDevice () != oif)
         {
-          RoutingTableEntry newrt;
-          if (m_routingTable.LookupRoute (rt.GetNextHop (),newrt))
-            {
-              route = newrt.GetRoute ();
-              NS_ASSERT (route != 0);
-              NS_LOG_DEBUG ("A route exists from " << route->GetSource ()
-                                                   << " to destination " << dst << " via "
-                                                   << rt.GetNextHop ());
-              if (oif != 0 && route->GetOutputDevice () != oif)
-                {
-                  NS_LOG_DEBUG ("Output device doesn't match. Dropped.");
-                  sockerr = Socket::ERROR_NOROUTETOHOST;
-                  return Ptr<Ipv4Route> ();
-                }
-              return route;
-            }
+          NS_LOG_DEBUG ("Output device doesn't match. Dropped.");
+          sockerr = Socket::ERROR_NOROUTETOHOST;
+          RecordDrop (p, header, DROP_INTERFACE_MISMATCH);
+          return Ptr<Ipv4Route> ();
         }
+      return route;
     }
 
   if (EnableBuffering)
@@ -352,6 +468,11 @@ DreamRoutingProtocol::RouteOutput (Ptr<Packet> p,
           p->AddPacketTag (tag);
         }
     }
+  else
+    {
+      // Without the tag RouteInput discards the looped back packet
+      RecordDrop (p, header, DROP_NO_ROUTE);
+    }
   return LoopbackRoute (header,oif);
 }
 
@@ -368,6 +489,8 @@ DreamRoutingProtocol::DeferredRouteOutput (Ptr<const Packet> p,
   if (result)
     {
       NS_LOG_DEBUG ("Added packet " << p->GetUid () << " to queue.");
+      m_statistics.enqueued++;
+      UpdateQueueOccupancy ();
     }
 }
 
@@ -392,7 +515,6 @@ DreamRoutingProtocol::RouteInput (Ptr<const Packet> p,
   NS_ASSERT (m_ipv4 != 0);
   // Check if input device supports IP
   NS_ASSERT (m_ipv4->GetInterfaceForDevice (idev) >= 0);
-  int32_t iif = m_ipv4->GetInterfaceForDevice (idev);
 
   Ipv4Address dst = header.GetDestination ();
   Ipv4Address origin = header.GetSource ();
@@ -413,55 +535,59 @@ DreamRoutingProtocol::RouteInput (Ptr<const Packet> p,
           return true;
         }
     }
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
-         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+  if (IsLocalAddress (origin))
     {
-      Ipv4InterfaceAddress iface = j->second;
-      if (origin == iface.GetLocal ())
-        {
-          return true;
-        }
+      return true;
     }
-  
+
+  // An earlier packet to dst on the same device was forwarded, and neither
+  // the routing table nor the addresses of the node changed since
+  ForwardingCacheEntry & cached = m_forwardingCache[Ipv4AddressHash () (dst) & (FORWARDING_CACHE_SIZE - 1)];
+  if (cached.route != 0 && cached.destination == dst && cached.device == idev
+      && cached.generation == m_routingTable.GetGeneration () && cached.addressGeneration == m_addressGeneration
+      && m_ipv4->IsForwarding (cached.interface))
+    {
+      NS_LOG_LOGIC (m_mainAddress << " is forwarding packet " << p->GetUid ()
+                                  << " to " << dst
+                                  << " from " << origin
+                                  << " via cached nexthop neighbor " << cached.route->GetGateway ());
+      ucb (cached.route,p,header);
+      return true;
+    }
+
+  int32_t iif = m_ipv4->GetInterfaceForDevice (idev);
+
   // LOCAL DELIVARY TO dream INTERFACES
 
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j
-       != m_socketAddresses.end (); ++j)
+  if (IsLocalBroadcast (dst, iif))
     {
-      Ipv4InterfaceAddress iface = j->second;
-      if (m_ipv4->GetInterfaceForAddress (iface.GetLocal ()) == iif)
+      Ptr<Packet> packet = p->Copy ();
+      if (lcb.IsNull () == false)
         {
-          if (dst == iface.GetBroadcast () || dst.IsBroadcast ())
+          NS_LOG_LOGIC ("Broadcast local delivery on interface " << iif);
+          lcb (p, header, iif);
+          // Fall through to additional processing
+        }
+      else
+        {
+          NS_LOG_ERROR ("Unable to deliver packet locally due to null callback " << p->GetUid () << " from " << origin);
+          ecb (p, header, Socket::ERROR_NOROUTETOHOST);
+        }
+      if (header.GetTtl () > 1)
+        {
+          NS_LOG_LOGIC ("Forward broadcast. TTL " << (uint16_t) header.GetTtl ());
+          const RoutingTableEntry *toBroadcast = m_routingTable.FindRoute (dst);
+          if (toBroadcast != 0 && dst != toBroadcast->GetInterface ().GetBroadcast ())
             {
-              Ptr<Packet> packet = p->Copy ();
-              if (lcb.IsNull () == false)
-                {
-                  NS_LOG_LOGIC ("Broadcast local delivery to " << iface.GetLocal ());
-                  lcb (p, header, iif);
-                  // Fall through to additional processing
-                }
-              else
-                {
-                  NS_LOG_ERROR ("Unable to deliver packet locally due to null callback " << p->GetUid () << " from " << origin);
-                  ecb (p, header, Socket::ERROR_NOROUTETOHOST);
-                }
-              if (header.GetTtl () > 1)
-                {
-                  NS_LOG_LOGIC ("Forward broadcast. TTL " << (uint16_t) header.GetTtl ());
-                  RoutingTableEntry toBroadcast;
-                  if (m_routingTable.LookupRoute (dst,toBroadcast,true))
-                    {
-                      Ptr<Ipv4Route> route = toBroadcast.GetRoute ();
-                      ucb (route,packet,header);
-                    }
-                  else
-                    {
-                      NS_LOG_DEBUG ("No route to forward. Drop packet " << p->GetUid ());
-                    }
-                }
-              return true;
+              Ptr<Ipv4Route> route = toBroadcast->GetRoute ();
+              ucb (route,packet,header);
+            }
+          else
+            {
+              NS_LOG_DEBUG ("No route to forward. Drop packet " << p->GetUid ());
             }
         }
+      return true;
     }
 
   if (m_ipv4->IsDestinationAddress (dst, iif))
@@ -487,23 +613,25 @@ DreamRoutingProtocol::RouteInput (Ptr<const Packet> p,
       return true;
     }
 
-  RoutingTableEntry toDst;
-  if (m_routingTable.LookupRoute (dst,toDst))
+  Ptr<Ipv4Route> route = m_routingTable.ResolveRoute (dst);
+  if (route != 0)
     {
-      RoutingTableEntry ne;
-      if (m_routingTable.LookupRoute (toDst.GetNextHop (),ne))
-        {
-          Ptr<Ipv4Route> route = ne.GetRoute ();
-          NS_LOG_LOGIC (m_mainAddress << " is forwarding packet " << p->GetUid ()
-                                      << " to " << dst
-                                      << " from " << header.GetSource ()
-                                      << " via nexthop neighbor " << toDst.GetNextHop ());
-          ucb (route,p,header);
-          return true;
-        }
+      NS_LOG_LOGIC (m_mainAddress << " is forwarding packet " << p->GetUid ()
+                                  << " to " << dst
+                                  << " from " << header.GetSource ()
+                                  << " via nexthop neighbor " << route->GetGateway ());
+      cached.destination = dst;
+      cached.device = idev;
+      cached.interface = iif;
+      cached.generation = m_routingTable.GetGeneration ();
+      cached.addressGeneration = m_addressGeneration;
+      cached.route = route;
+      ucb (route,p,header);
+      return true;
     }
   NS_LOG_LOGIC ("Drop packet " << p->GetUid ()
                                << " as there is no route to forward it.");
+  RecordDrop (p, header, DROP_NO_ROUTE);
   return false;
 }
 
@@ -530,24 +658,22 @@ DreamRoutingProtocol::LoopbackRoute (const Ipv4Header & hdr, Ptr<NetDevice> oif)
   // If RouteOutput() caller specified an outgoing interface, that
   // further constrains the selection of source address
   //
-  std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin ();
+  std::map<Ptr<Socket>, SocketContext>::const_iterator j = m_socketAddresses.begin ();
   if (oif)
     {
       // Iterate to find an address on the oif device
       for (j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
         {
-          Ipv4Address addr = j->second.GetLocal ();
-          int32_t interface = m_ipv4->GetInterfaceForAddress (addr);
-          if (oif == m_ipv4->GetNetDevice (static_cast<uint32_t> (interface)))
+          if (oif == j->second.device)
             {
-              rt->SetSource (addr);
+              rt->SetSource (j->second.iface.GetLocal ());
               break;
             }
         }
     }
   else
     {
-      rt->SetSource (j->second.GetLocal ());
+      rt->SetSource (j->second.iface.GetLocal ());
     }
   NS_ASSERT_MSG (rt->GetSource () != Ipv4Address (), "Valid dream source address not found");
   rt->SetGateway (Ipv4Address ("127.0.0.1"));
@@ -556,83 +682,94 @@ DreamRoutingProtocol::LoopbackRoute (const Ipv4Header & hdr, Ptr<NetDevice> oif)
 }
 
 void
-DreamRoutingProtocol::RecvDream (Ptr<Socket> socket)
+DreamRoutingProtocol::RecvDream (Ptr<Socket> socket, SocketContext const & context)
 {
   Address sourceAddress;
-  Ptr<Packet> advpacket = Create<Packet> ();
   Ptr<Packet> packet = socket->RecvFrom (sourceAddress);
   InetSocketAddress inetSourceAddr = InetSocketAddress::ConvertFrom (sourceAddress);
   Ipv4Address sender = inetSourceAddr.GetIpv4 ();
-  Ipv4Address receiver = m_socketAddresses[socket].GetLocal ();
-  Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (receiver));
+  Ipv4Address receiver = context.iface.GetLocal ();
   uint32_t packetSize = packet->GetSize ();
   NS_LOG_FUNCTION (m_mainAddress << " received dream packet of size: " << packetSize
                                  << " and packet id: " << packet->GetUid ());
+  // The record count is only trusted once the packet is known to hold that many records
   uint32_t count = 0;
-  for (; packetSize > 0; packetSize = packetSize - 12)
+  if (packetSize >= DreamUpdateHeader::SENDER_BLOCK_SIZE)
+    {
+      // The version is followed by the record count in network byte order
+      uint8_t block[3];
+      packet->CopyData (block, sizeof (block));
+      count = (block[1] << 8) | block[2];
+    }
+  if (packetSize < DreamUpdateHeader::SENDER_BLOCK_SIZE + count * DreamHeader::RECORD_SIZE)
     {
-      count = 0;
-      DreamHeader dreamHeader, tempDreamHeader;
-      packet->RemoveHeader (dreamHeader);
+      NS_LOG_DEBUG ("Discarding update of " << packetSize << " bytes, too short for " << count << " records");
+      m_statistics.malformedUpdates++;
+      return;
+    }
+  DreamUpdateHeader updateHeader;
+  packet->RemoveHeader (updateHeader);
+  if (updateHeader.GetVersion () != DreamUpdateHeader::VERSION)
+    {
+      NS_LOG_DEBUG ("Discarding update of unknown version " << (uint32_t) updateHeader.GetVersion ());
+      return;
+    }
+  ///Adding the position and speed of the node or update it if was found before
+  m_routingTable.AddMobilityData (updateHeader.GetSrc (),updateHeader.GetX (),updateHeader.GetY (),updateHeader.GetSpeed ());
+  // Destinations whose route was installed, refreshed or repaired by this update
+  std::vector<Ipv4Address> installed;
+  const std::vector<DreamHeader> & records = updateHeader.GetRecords ();
+  for (std::vector<DreamHeader>::const_iterator record = records.begin (); record != records.end (); ++record)
+    {
+      const DreamHeader & dreamHeader = *record;
       NS_LOG_DEBUG ("Processing new update for " << dreamHeader.GetDst ());
       /*Verifying if the packets sent by me were returned back to me. If yes, discarding them!*/
-      for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j
-           != m_socketAddresses.end (); ++j)
+      if (IsLocalAddress (dreamHeader.GetDst ()))
         {
-          Ipv4InterfaceAddress interface = j->second;
-          if (dreamHeader.GetDst () == interface.GetLocal ())
+          if (dreamHeader.GetDstSeqno () % 2 == 1)
             {
-              if (dreamHeader.GetDstSeqno () % 2 == 1)
-                {
-                  NS_LOG_DEBUG ("Sent dream update back to the same Destination, "
-                                "with infinite metric. Time left to send fwd update: "
-                                << m_periodicUpdateTimer.GetDelayLeft ());
-                  count++;
-                }
-              else
-                {
-                  NS_LOG_DEBUG ("Received update for my address. Discarding this.");
-                  count++;
-                }
+              NS_LOG_DEBUG ("Sent dream update back to the same Destination, "
+                            "with infinite metric. Time left to send fwd update: "
+                            << m_periodicUpdateTimer.GetDelayLeft ());
+            }
+          else
+            {
+              NS_LOG_DEBUG ("Received update for my address. Discarding this.");
             }
-        }
-      if (count > 0)
-        {
           continue;
         }
       NS_LOG_DEBUG ("Received a dream packet from "
                     << sender << " to " << receiver << ". Details are: Destination: " << dreamHeader.GetDst () << ", Seq No: "
                     << dreamHeader.GetDstSeqno () << ", HopCount: " << dreamHeader.GetHopCount ());
-      
-      ///Adding the position and speed of the node or update it if was found before
-      
-      Ipv4Address source=dreamHeader.GetSrc();
-
-      m_routingTable.AddMobilityData(source,dreamHeader.GetX(),dreamHeader.GetY(),dreamHeader.GetSpeed());
-
-      //////////////////////////
-      RoutingTableEntry fwdTableEntry, advTableEntry;
-      EventId event;
-      bool permanentTableVerifier = m_routingTable.LookupRoute (dreamHeader.GetDst (),fwdTableEntry);
-      if (permanentTableVerifier == false)
+      // The route, the pending advertisement and the settling time of the destination, found with one lookup
+      DestinationRecord *destination = m_routingTable.FindRecord (dreamHeader.GetDst ());
+      if (destination == 0 || !destination->HasRoute ())
         {
           if (dreamHeader.GetDstSeqno () % 2 != 1)
             {
               NS_LOG_DEBUG ("Received New Route!");
               RoutingTableEntry newEntry (
-                /*device=*/ dev, /*dst=*/
+                /*device=*/ context.device, /*dst=*/
                 dreamHeader.GetDst (), /*seqno=*/
                 dreamHeader.GetDstSeqno (),
-                /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0),
+                /*iface=*/ context.iface,
                 /*hops=*/ dreamHeader.GetHopCount (), /*next hop=*/
                 sender, /*lifetime=*/
                 Simulator::Now (), /*settlingTime*/
                 m_settlingTime, /*entries changed*/
                 true);
               newEntry.SetFlag (VALID);
-              m_routingTable.AddRoute (newEntry);
+              if (destination == 0)
+                {
+                  destination = &m_routingTable.AddRecord (dreamHeader.GetDst ());
+                }
+              m_routingTable.SetRoute (*destination, newEntry);
+              installed.push_back (dreamHeader.GetDst ());
               NS_LOG_DEBUG ("New Route added to both tables");
-              m_advRoutingTable.AddRoute (newEntry);
+              if (!destination->HasAdvertisement ())
+                {
+                  m_routingTable.SetAdvertisement (*destination, newEntry);
+                }
             }
           else
             {
@@ -643,25 +780,26 @@ DreamRoutingProtocol::RecvDream (Ptr<Socket> socket)
         }
       else
         {
-          if (!m_advRoutingTable.LookupRoute (dreamHeader.GetDst (),advTableEntry))
+          if (!destination->HasAdvertisement ())
             {
-              RoutingTableEntry tr;
-              std::map<Ipv4Address, RoutingTableEntry> allRoutes;
-              m_advRoutingTable.GetListOfAllRoutes (allRoutes);
-              for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = allRoutes.begin (); i != allRoutes.end (); ++i)
-                {
-                  NS_LOG_DEBUG ("ADV table routes are:" << i->second.GetDestination ());
-                }
               // present in fwd table and not in advtable
-              m_advRoutingTable.AddRoute (fwdTableEntry);
-              m_advRoutingTable.LookupRoute (dreamHeader.GetDst (),advTableEntry);
+              m_routingTable.SetAdvertisement (*destination, destination->GetRouteEntry ());
             }
+          RoutingTableEntry advTableEntry = destination->GetAdvertisement ();
           if (dreamHeader.GetDstSeqno () % 2 != 1)
             {
+              const RoutingTableEntry & mainRoute = destination->GetRouteEntry ();
+              if (EnableBackupNextHops && sender != mainRoute.GetNextHop ()
+                  && dreamHeader.GetDstSeqno () >= mainRoute.GetSeqNo ()
+                  && dreamHeader.GetHopCount () <= mainRoute.GetHop ())
+                {
+                  // Another neighbour with as good a metric: its path does not go through this node
+                  m_routingTable.AddBackup (*destination, sender, dreamHeader.GetHopCount ());
+                }
               if (dreamHeader.GetDstSeqno () > advTableEntry.GetSeqNo ())
                 {
                   // Received update with better seq number. Clear any old events that are running
-                  if (m_advRoutingTable.ForceDeleteIpv4Event (dreamHeader.GetDst ()))
+                  if (m_routingTable.CancelSettling (*destination))
                     {
                       NS_LOG_DEBUG ("Canceling the timer to update route with better seq number");
                     }
@@ -672,26 +810,19 @@ DreamRoutingProtocol::RecvDream (Ptr<Socket> socket)
                       advTableEntry.SetLifeTime (Simulator::Now ());
                       advTableEntry.SetFlag (VALID);
                       advTableEntry.SetEntriesChanged (true);
-                      //////Maisha////////////
-                      Ipv4Address temp=Ipv4Address();
-                      Ipv4Address a=m_routingTable.getClosestAddress(dreamHeader.GetDst ());
-                      if(a==temp)
                       advTableEntry.SetNextHop (sender);
-                      else
-                      advTableEntry.SetNextHop (a);
-                      //////////////////
                       advTableEntry.SetHop (dreamHeader.GetHopCount ());
                       NS_LOG_DEBUG ("Received update with better sequence number and changed metric.Waiting for WST");
-                      Time tempSettlingtime = GetSettlingTime (dreamHeader.GetDst ());
+                      Time tempSettlingtime = GetSettlingTime (destination->GetRouteEntry ());
                       advTableEntry.SetSettlingTime (tempSettlingtime);
                       NS_LOG_DEBUG ("Added Settling Time:" << tempSettlingtime.As (Time::S)
                                                            << " as there is no event running for this route");
-                      event = Simulator::Schedule (tempSettlingtime,&DreamRoutingProtocol::SendTriggeredUpdate,this);
-                      m_advRoutingTable.AddIpv4Event (dreamHeader.GetDst (),event);
-                      NS_LOG_DEBUG ("EventCreated EventUID: " << event.GetUid ());
+                      m_routingTable.SetSettlingDeadline (*destination,Simulator::Now () + tempSettlingtime);
+                      ScheduleTriggeredUpdate (tempSettlingtime);
                       // if received changed metric, use it but adv it only after wst
-                      m_routingTable.Update (advTableEntry);
-                      m_advRoutingTable.Update (advTableEntry);
+                      m_routingTable.SetRoute (*destination, advTableEntry);
+                      installed.push_back (dreamHeader.GetDst ());
+                      m_routingTable.SetAdvertisement (*destination, advTableEntry);
                     }
                   else
                     {
@@ -700,16 +831,9 @@ DreamRoutingProtocol::RecvDream (Ptr<Socket> socket)
                       advTableEntry.SetLifeTime (Simulator::Now ());
                       advTableEntry.SetFlag (VALID);
                       advTableEntry.SetEntriesChanged (true);
-                      //////Maisha////////////
-                      Ipv4Address temp=Ipv4Address();
-                      Ipv4Address a=m_routingTable.getClosestAddress(dreamHeader.GetDst ());
-                      if(a==temp)
                       advTableEntry.SetNextHop (sender);
-                      else
-                      advTableEntry.SetNextHop (a);
-                      //////////////////
                       advTableEntry.SetHop (dreamHeader.GetHopCount ());
-                      m_advRoutingTable.Update (advTableEntry);
+                      m_routingTable.SetAdvertisement (*destination, advTableEntry);
                       NS_LOG_DEBUG ("Route with better sequence number and same metric received. Advertised without WST");
                     }
                 }
@@ -722,49 +846,54 @@ DreamRoutingProtocol::RecvDream (Ptr<Socket> socket)
                        */
                       NS_LOG_DEBUG ("Canceling any existing timer to update route with same sequence number "
                                     "and better hop count");
-                      m_advRoutingTable.ForceDeleteIpv4Event (dreamHeader.GetDst ());
+                      m_routingTable.CancelSettling (*destination);
                       advTableEntry.SetSeqNo (dreamHeader.GetDstSeqno ());
                       advTableEntry.SetLifeTime (Simulator::Now ());
                       advTableEntry.SetFlag (VALID);
                       advTableEntry.SetEntriesChanged (true);
-                      //////Maisha////////////
-                      Ipv4Address temp=Ipv4Address();
-                      Ipv4Address a=m_routingTable.getClosestAddress(dreamHeader.GetDst ());
-                      if(a==temp)
                       advTableEntry.SetNextHop (sender);
-                      else
-                      advTableEntry.SetNextHop (a);
-                      //////////////////
-                     
                       advTableEntry.SetHop (dreamHeader.GetHopCount ());
-                      Time tempSettlingtime = GetSettlingTime (dreamHeader.GetDst ());
+                      Time tempSettlingtime = GetSettlingTime (destination->GetRouteEntry ());
                       advTableEntry.SetSettlingTime (tempSettlingtime);
                       NS_LOG_DEBUG ("Added Settling Time," << tempSettlingtime.As (Time::S)
                                                            << " as there is no current event running for this route");
-                      event = Simulator::Schedule (tempSettlingtime,&DreamRoutingProtocol::SendTriggeredUpdate,this);
-                      m_advRoutingTable.AddIpv4Event (dreamHeader.GetDst (),event);
-                      NS_LOG_DEBUG ("EventCreated EventUID: " << event.GetUid ());
+                      m_routingTable.SetSettlingDeadline (*destination,Simulator::Now () + tempSettlingtime);
+                      ScheduleTriggeredUpdate (tempSettlingtime);
                       // if received changed metric, use it but adv it only after wst
-                      m_routingTable.Update (advTableEntry);
-                      m_advRoutingTable.Update (advTableEntry);
+                      m_routingTable.SetRoute (*destination, advTableEntry);
+                      installed.push_back (dreamHeader.GetDst ());
+                      m_routingTable.SetAdvertisement (*destination, advTableEntry);
                     }
                   else
                     {
                       /*Received update with same seq number but with same or greater hop count.
                        * Discard that update.
                        */
-                      if (!m_advRoutingTable.AnyRunningEvent (dreamHeader.GetDst ()))
+                      if (!destination->IsSettling ())
                         {
+                          if (EnableGeographicNextHop && dreamHeader.GetHopCount () == advTableEntry.GetHop ()
+                              && sender != advTableEntry.GetNextHop ()
+                              && m_routingTable.IsBetterGeographicNextHop (dreamHeader.GetDst (), m_mainAddress, sender,
+                                                                           advTableEntry.GetNextHop ()))
+                            {
+                              // Same sequence number and metric as the current next hop, and toward the expected zone
+                              NS_LOG_DEBUG ("Moving the route to " << dreamHeader.GetDst () << " from "
+                                                                   << advTableEntry.GetNextHop () << " to " << sender
+                                                                   << " which is in the expected zone cone");
+                              advTableEntry.SetNextHop (sender);
+                              advTableEntry.SetInterface (context.iface);
+                              advTableEntry.SetOutputDevice (context.device);
+                            }
                           /*update the timer only if nexthop address matches thus discarding
                            * updates to that destination from other nodes.
                            */
                           if (advTableEntry.GetNextHop () == sender)
                             {
                               advTableEntry.SetLifeTime (Simulator::Now ());
-                              m_routingTable.Update (advTableEntry);
+                              m_routingTable.SetRoute (*destination, advTableEntry);
+                              installed.push_back (dreamHeader.GetDst ());
                             }
-                          m_advRoutingTable.DeleteRoute (
-                            dreamHeader.GetDst ());
+                          m_routingTable.DeleteAdvertisement (*destination);
                         }
                       NS_LOG_DEBUG ("Received update with same seq number and "
                                     "same/worst metric for, " << dreamHeader.GetDst () << ". Discarding the update.");
@@ -773,9 +902,9 @@ DreamRoutingProtocol::RecvDream (Ptr<Socket> socket)
               else
                 {
                   // Received update with an old sequence number. Discard the update
-                  if (!m_advRoutingTable.AnyRunningEvent (dreamHeader.GetDst ()))
+                  if (!destination->IsSettling ())
                     {
-                      m_advRoutingTable.DeleteRoute (dreamHeader.GetDst ());
+                      m_routingTable.DeleteAdvertisement (*destination);
                     }
                   NS_LOG_DEBUG (dreamHeader.GetDst () << " : Received update with old seq number. Discarding the update.");
                 }
@@ -787,27 +916,45 @@ DreamRoutingProtocol::RecvDream (Ptr<Socket> socket)
               // Delete route only if update was received from my nexthop neighbor
               if (sender == advTableEntry.GetNextHop ())
                 {
-                  NS_LOG_DEBUG ("Triggering an update for this unreachable route:");
-                  std::map<Ipv4Address, RoutingTableEntry> dstsWithNextHopSrc;
-                  m_routingTable.GetListOfDestinationWithNextHop (dreamHeader.GetDst (),dstsWithNextHopSrc);
-                  m_routingTable.DeleteRoute (dreamHeader.GetDst ());
-                  advTableEntry.SetSeqNo (dreamHeader.GetDstSeqno ());
-                  advTableEntry.SetEntriesChanged (true);
-                  m_advRoutingTable.Update (advTableEntry);
-                  for (std::map<Ipv4Address, RoutingTableEntry>::iterator i = dstsWithNextHopSrc.begin (); i
+                  bool failedOver = m_routingTable.FailOver (*destination, sender);
+                  if (failedOver)
+                    {
+                      NS_LOG_DEBUG ("Moved the route to " << dreamHeader.GetDst () << " to backup next hop "
+                                                          << destination->GetRouteEntry ().GetNextHop ());
+                      m_statistics.failovers++;
+                      if (!destination->IsSettling ())
+                        {
+                          m_routingTable.DeleteAdvertisement (*destination);
+                        }
+                    }
+                  else
+                    {
+                      NS_LOG_DEBUG ("Triggering an update for this unreachable route:");
+                      advTableEntry.SetSeqNo (dreamHeader.GetDstSeqno ());
+                      advTableEntry.SetEntriesChanged (true);
+                      m_routingTable.SetAdvertisement (*destination, advTableEntry);
+                    }
+                  // Removing routes moves records around, destination is not used past this point
+                  std::vector<RoutingTableEntry> dstsWithNextHopSrc;
+                  m_statistics.failovers += m_routingTable.FailOverRoutesWithNextHop (dreamHeader.GetDst (),
+                                                                                      dstsWithNextHopSrc);
+                  if (!failedOver)
+                    {
+                      m_routingTable.DeleteRoute (dreamHeader.GetDst ());
+                    }
+                  for (std::vector<RoutingTableEntry>::iterator i = dstsWithNextHopSrc.begin (); i
                        != dstsWithNextHopSrc.end (); ++i)
                     {
-                      i->second.SetSeqNo (i->second.GetSeqNo () + 1);
-                      i->second.SetEntriesChanged (true);
-                      m_advRoutingTable.AddRoute (i->second);
-                      m_routingTable.DeleteRoute (i->second.GetDestination ());
+                      i->SetSeqNo (i->GetSeqNo () + 1);
+                      i->SetEntriesChanged (true);
+                      m_routingTable.AddAdvertisement (*i);
                     }
                 }
               else
                 {
-                  if (!m_advRoutingTable.AnyRunningEvent (dreamHeader.GetDst ()))
+                  if (!destination->IsSettling ())
                     {
-                      m_advRoutingTable.DeleteRoute (dreamHeader.GetDst ());
+                      m_routingTable.DeleteAdvertisement (*destination);
                     }
                   NS_LOG_DEBUG (dreamHeader.GetDst () <<
                                 " : Discard this link break update as it was received from a different neighbor "
@@ -816,225 +963,214 @@ DreamRoutingProtocol::RecvDream (Ptr<Socket> socket)
             }
         }
     }
-  std::map<Ipv4Address, RoutingTableEntry> allRoutes;
-  m_advRoutingTable.GetListOfAllRoutes (allRoutes);
-  if (EnableRouteAggregation && allRoutes.size () > 0)
+  m_routingTable.TakeFailedOver (installed);
+  DrainQueue (installed);
+  ScheduleRouteExpiry ();
+  if (EnableRouteAggregation && m_routingTable.PendingAdvertisementsSize () > 0)
     {
-      Simulator::Schedule (m_routeAggregationTime,&DreamRoutingProtocol::SendTriggeredUpdate,this);
+      ScheduleTriggeredUpdate (m_routeAggregationTime);
     }
   else
     {
-      Simulator::Schedule (MicroSeconds (m_uniformRandomVariable->GetInteger (0,1000)),&DreamRoutingProtocol::SendTriggeredUpdate,this);
+      ScheduleTriggeredUpdate (MicroSeconds (m_uniformRandomVariable->GetInteger (0,1000)));
     }
 }
 
 
+DreamRoutingProtocol::LocalState
+DreamRoutingProtocol::GetLocalState ()
+{
+  if (m_mobility == 0)
+    {
+      // Mobility may be installed after the routing protocol
+      m_mobility = m_ipv4->GetObject<MobilityModel> ();
+    }
+  LocalState state = { 0, 0, 0.0 };
+  if (m_mobility != 0)
+    {
+      Vector position = m_mobility->GetPosition ();
+      Vector velocity = m_mobility->GetVelocity ();
+      state.x = (uint32_t)(position.x);
+      state.y = (uint32_t)(position.y);
+      state.speed = (float)(std::sqrt (velocity.x * velocity.x + velocity.y * velocity.y + velocity.z * velocity.z));
+    }
+  return state;
+}
+
 void
-DreamRoutingProtocol::SendTriggeredUpdate ()
+DreamRoutingProtocol::SendUpdate (const DreamUpdateHeader & updateHeader)
 {
-  NS_LOG_FUNCTION (m_mainAddress << " is sending a triggered update");
-  std::map<Ipv4Address, RoutingTableEntry> allRoutes;
-  m_advRoutingTable.GetListOfAllRoutes (allRoutes);
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (updateHeader);
+  for (std::map<Ptr<Socket>, SocketContext>::const_iterator j = m_socketAddresses.begin (); j
        != m_socketAddresses.end (); ++j)
     {
-      DreamHeader dreamHeader;
       Ptr<Socket> socket = j->first;
-      Ipv4InterfaceAddress iface = j->second;
-      Ptr<Packet> packet = Create<Packet> ();
-      for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = allRoutes.begin (); i != allRoutes.end (); ++i)
+      Ipv4InterfaceAddress iface = j->second.iface;
+      // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
+      Ipv4Address destination;
+      if (iface.GetMask () == Ipv4Mask::GetOnes ())
         {
-          NS_LOG_LOGIC ("Destination: " << i->second.GetDestination ()
-                                        << " SeqNo:" << i->second.GetSeqNo () << " HopCount:"
-                                        << i->second.GetHop () + 1);
-          RoutingTableEntry temp = i->second;
-          if ((i->second.GetEntriesChanged () == true) && (!m_advRoutingTable.AnyRunningEvent (temp.GetDestination ())))
-            {
-              dreamHeader.SetDst (i->second.GetDestination ());
-              dreamHeader.SetDstSeqno (i->second.GetSeqNo ());
-              dreamHeader.SetHopCount (i->second.GetHop () + 1);
-              temp.SetFlag (VALID);
-              temp.SetEntriesChanged (false);
-              m_advRoutingTable.DeleteIpv4Event (temp.GetDestination ());
-              if (!(temp.GetSeqNo () % 2))
-                {
-                  m_routingTable.Update (temp);
-                }
-              ////////////////Maisha//////////////////
-              Ptr<Node> node=m_ipv4->GetObject<Node> ();
-              Ptr<MobilityModel> mob=m_ipv4->GetObject<MobilityModel> ();
-              dreamHeader.SetSrc(m_mainAddress);
-              dreamHeader.SetX((uint32_t)(mob->GetPosition().x));
-              dreamHeader.SetY((uint32_t)(mob->GetPosition().y));
-              double vx=mob->GetVelocity().x;
-              double vy=mob->GetVelocity().y;
-              double vz=mob->GetVelocity().z;
-              double v=sqrt(vx*vx+vy*vy+vz*vz);
-              dreamHeader.SetSpeed((float)(v));
-              ///////////////////////////////
-              packet->AddHeader (dreamHeader);
-              m_advRoutingTable.DeleteRoute (temp.GetDestination ());
-              NS_LOG_DEBUG ("Deleted this route from the advertised table");
-            }
-          else
-            {
-              EventId event = m_advRoutingTable.GetEventId (temp.GetDestination ());
-              NS_ASSERT (event.GetUid () != 0);
-              NS_LOG_DEBUG ("EventID " << event.GetUid () << " associated with "
-                                       << temp.GetDestination () << " has not expired, waiting in adv table");
-            }
+          destination = Ipv4Address ("255.255.255.255");
         }
-      if (packet->GetSize () >= 12)
+      else
         {
-          RoutingTableEntry temp2;
-          m_routingTable.LookupRoute (m_ipv4->GetAddress (1, 0).GetBroadcast (), temp2);
-          dreamHeader.SetDst (m_ipv4->GetAddress (1, 0).GetLocal ());
-          dreamHeader.SetDstSeqno (temp2.GetSeqNo ());
-          dreamHeader.SetHopCount (temp2.GetHop () + 1);
-          ////////////////Maisha//////////////////
-          Ptr<Node> node=m_ipv4->GetObject<Node> ();
-          Ptr<MobilityModel> mob=m_ipv4->GetObject<MobilityModel> ();
-              dreamHeader.SetSrc(m_mainAddress);
-              dreamHeader.SetX((uint32_t)(mob->GetPosition().x));
-              dreamHeader.SetY((uint32_t)(mob->GetPosition().y));
-              double vx=mob->GetVelocity().x;
-              double vy=mob->GetVelocity().y;
-              double vz=mob->GetVelocity().z;
-              double v=sqrt(vx*vx+vy*vy+vz*vz);
-              dreamHeader.SetSpeed((float)(v));
-              ///////////////////////////////
-          NS_LOG_DEBUG ("Adding my update as well to the packet");
-          packet->AddHeader (dreamHeader);
-          // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
-          Ipv4Address destination;
-          if (iface.GetMask () == Ipv4Mask::GetOnes ())
-            {
-              destination = Ipv4Address ("255.255.255.255");
-            }
-          else
-            {
-              destination = iface.GetBroadcast ();
-            }
-          socket->SendTo (packet, 0, InetSocketAddress (destination, DREAM_PORT));
-          NS_LOG_FUNCTION ("Sent Triggered Update from "
-                           << dreamHeader.GetDst ()
-                           << " with packet id : " << packet->GetUid () << " and packet Size: " << packet->GetSize ());
+          destination = iface.GetBroadcast ();
         }
-      else
+      // Copies share the serialized update until one of them is written to
+      Ptr<Packet> copy = packet->Copy ();
+      socket->SendTo (copy, 0, InetSocketAddress (destination, DREAM_PORT));
+      NS_LOG_FUNCTION ("Sent update on " << iface.GetLocal ()
+                                         << " with packet id : " << copy->GetUid () << " and packet Size: " << copy->GetSize ());
+    }
+}
+
+void
+DreamRoutingProtocol::SendTriggeredUpdate ()
+{
+  NS_LOG_FUNCTION (m_mainAddress << " is sending a triggered update");
+  // Only the changed routes are visited; the ones still settling stay in the advertised table
+  std::vector<RoutingTableEntry> ready;
+  m_routingTable.TakeChangedRoutes (ready);
+  LocalState state = GetLocalState ();
+  DreamHeader dreamHeader;
+  DreamUpdateHeader updateHeader (m_mainAddress,state.x,state.y,state.speed);
+  for (std::vector<RoutingTableEntry>::iterator i = ready.begin (); i != ready.end (); ++i)
+    {
+      NS_LOG_LOGIC ("Destination: " << i->GetDestination ()
+                                    << " SeqNo:" << i->GetSeqNo () << " HopCount:"
+                                    << i->GetHop () + 1);
+      dreamHeader.SetDst (i->GetDestination ());
+      dreamHeader.SetDstSeqno (i->GetSeqNo ());
+      dreamHeader.SetHopCount (i->GetHop () + 1);
+      if (!(i->GetSeqNo () % 2))
         {
-          NS_LOG_FUNCTION ("Update not sent as there are no updates to be triggered");
+          // In the main table the changed flag marks the route for the next incremental dump
+          i->SetEntriesChanged (EnableIncrementalDump);
+          m_routingTable.Update (*i);
         }
+      updateHeader.AddRecord (dreamHeader);
+    }
+  if (updateHeader.GetNumRecords () > 0)
+    {
+      RoutingTableEntry temp2;
+      m_routingTable.LookupRoute (m_ipv4->GetAddress (1, 0).GetBroadcast (), temp2);
+      dreamHeader.SetDst (m_ipv4->GetAddress (1, 0).GetLocal ());
+      dreamHeader.SetDstSeqno (temp2.GetSeqNo ());
+      dreamHeader.SetHopCount (temp2.GetHop () + 1);
+      NS_LOG_DEBUG ("Adding my update as well to the packet");
+      updateHeader.AddRecord (dreamHeader);
+      NS_LOG_FUNCTION ("Sending Triggered Update from " << dreamHeader.GetDst ());
+      SendUpdate (updateHeader);
+      m_lastTriggeredUpdate = Simulator::Now ();
+    }
+  else
+    {
+      NS_LOG_FUNCTION ("Update not sent as there are no updates to be triggered");
+    }
+  // The routes still waiting for their settling time go out with a later update
+  Time next;
+  if (m_routingTable.GetNextSettlingDeadline (next))
+    {
+      ScheduleTriggeredUpdate (next - Simulator::Now ());
     }
 }
 
+void
+DreamRoutingProtocol::ScheduleTriggeredUpdate (Time delay)
+{
+  Time when = std::max (Simulator::Now () + delay, m_lastTriggeredUpdate + m_minTriggeredUpdateInterval);
+  if (m_triggeredExpireTimer.IsRunning ())
+    {
+      if (m_triggeredExpireTimer.GetDelayLeft () <= when - Simulator::Now ())
+        {
+          // The pending update carries the new changes as well
+          return;
+        }
+      m_triggeredExpireTimer.Cancel ();
+    }
+  m_triggeredExpireTimer.Schedule (when - Simulator::Now ());
+}
+
 void
 DreamRoutingProtocol::SendPeriodicUpdate ()
 {
-  std::map<Ipv4Address, RoutingTableEntry> removedAddresses, allRoutes;
-  m_routingTable.Purge (removedAddresses);
+  std::map<Ipv4Address, RoutingTableEntry> removedAddresses;
+  m_statistics.failovers += m_routingTable.Purge (removedAddresses);
+  std::vector<Ipv4Address> failedOver;
+  m_routingTable.TakeFailedOver (failedOver);
+  DrainQueue (failedOver);
+  m_routingTable.PurgeLocations ();
   MergeTriggerPeriodicUpdates ();
-  m_routingTable.GetListOfAllRoutes (allRoutes);
-  if (allRoutes.empty ())
+  // Changes made to the table below do not reach the snapshot being walked
+  const std::vector<RoutingTableEntry> & allRoutes = m_routingTable.GetRouteSnapshot ();
+  if (std::find_if (allRoutes.begin (), allRoutes.end (), &IsAdvertised) == allRoutes.end ())
     {
       return;
     }
-  NS_LOG_FUNCTION (m_mainAddress << " is sending out its periodic update");
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j
-       != m_socketAddresses.end (); ++j)
+  bool fullDump = !EnableIncrementalDump || (m_periodicUpdateCount % m_fullDumpPeriod == 0);
+  m_periodicUpdateCount++;
+  NS_LOG_FUNCTION (m_mainAddress << " is sending out its periodic update" << (fullDump ? "" : " (incremental)"));
+  LocalState state = GetLocalState ();
+  DreamUpdateHeader updateHeader (m_mainAddress,state.x,state.y,state.speed);
+  for (std::vector<RoutingTableEntry>::const_iterator i = allRoutes.begin (); i != allRoutes.end (); ++i)
     {
-      Ptr<Socket> socket = j->first;
-      Ipv4InterfaceAddress iface = j->second;
-      Ptr<Packet> packet = Create<Packet> ();
-      for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = allRoutes.begin (); i != allRoutes.end (); ++i)
+      if (!IsAdvertised (*i))
         {
-          DreamHeader dreamHeader;
-          if (i->second.GetHop () == 0)
-            {
-              RoutingTableEntry ownEntry;
-              dreamHeader.SetDst (m_ipv4->GetAddress (1,0).GetLocal ());
-              dreamHeader.SetDstSeqno (i->second.GetSeqNo () + 2);
-              dreamHeader.SetHopCount (i->second.GetHop () + 1);
-              ////////////////Maisha//////////////////
-              Ptr<Node> node=m_ipv4->GetObject<Node> ();
-               Ptr<MobilityModel> mob=m_ipv4->GetObject<MobilityModel> ();
-              dreamHeader.SetSrc(m_mainAddress);
-              dreamHeader.SetX((uint32_t)(mob->GetPosition().x));
-              dreamHeader.SetY((uint32_t)(mob->GetPosition().y));
-              double vx=mob->GetVelocity().x;
-              double vy=mob->GetVelocity().y;
-              double vz=mob->GetVelocity().z;
-              double v=sqrt(vx*vx+vy*vy+vz*vz);
-              dreamHeader.SetSpeed((float)(v));
-              m_routingTable.AddMobilityData(m_mainAddress,dreamHeader.GetX(),dreamHeader.GetY(),v);
-              ///////////////////////////////
-              m_routingTable.LookupRoute (m_ipv4->GetAddress (1,0).GetBroadcast (),ownEntry);
-              ownEntry.SetSeqNo (dreamHeader.GetDstSeqno ());
-              m_routingTable.Update (ownEntry);
-              packet->AddHeader (dreamHeader);
-            }
-          else
-            {
-              dreamHeader.SetDst (i->second.GetDestination ());
-              dreamHeader.SetDstSeqno ((i->second.GetSeqNo ()));
-              dreamHeader.SetHopCount (i->second.GetHop () + 1);
-              ////////////////Maisha//////////////////
-              Ptr<Node> node=m_ipv4->GetObject<Node> ();
-               Ptr<MobilityModel> mob=m_ipv4->GetObject<MobilityModel> ();
-              dreamHeader.SetSrc(m_mainAddress);
-              dreamHeader.SetX((uint32_t)(mob->GetPosition().x));
-              dreamHeader.SetY((uint32_t)(mob->GetPosition().y));
-              double vx=mob->GetVelocity().x;
-              double vy=mob->GetVelocity().y;
-              double vz=mob->GetVelocity().z;
-              double v=sqrt(vx*vx+vy*vy+vz*vz);
-              dreamHeader.SetSpeed((float)(v));
-              ///////////////////////////////
-              packet->AddHeader (dreamHeader);
-            }
-          NS_LOG_DEBUG ("Forwarding the update for " << i->first);
-          NS_LOG_DEBUG ("Forwarding details are, Destination: " << dreamHeader.GetDst ()
-                                                                << ", SeqNo:" << dreamHeader.GetDstSeqno ()
-                                                                << ", HopCount:" << dreamHeader.GetHopCount ()
-                                                                << ", LifeTime: " << i->second.GetLifeTime ().As (Time::S));
+          continue;
         }
-      for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator rmItr = removedAddresses.begin (); rmItr
-           != removedAddresses.end (); ++rmItr)
+      DreamHeader dreamHeader;
+      if (EnableIncrementalDump && i->GetEntriesChanged ())
         {
-          DreamHeader removedHeader;
-          removedHeader.SetDst (rmItr->second.GetDestination ());
-          removedHeader.SetDstSeqno (rmItr->second.GetSeqNo () + 1);
-          removedHeader.SetHopCount (rmItr->second.GetHop () + 1);
-          ////////////////Maisha//////////////////
-              Ptr<Node> node=m_ipv4->GetObject<Node> ();
-               Ptr<MobilityModel> mob=m_ipv4->GetObject<MobilityModel> ();
-              removedHeader.SetSrc(m_mainAddress);
-              removedHeader.SetX((uint32_t)(mob->GetPosition().x));
-              removedHeader.SetY((uint32_t)(mob->GetPosition().y));
-              double vx=mob->GetVelocity().x;
-              double vy=mob->GetVelocity().y;
-              double vz=mob->GetVelocity().z;
-              double v=sqrt(vx*vx+vy*vy+vz*vz);
-              removedHeader.SetSpeed((float)(v));
-              ///////////////////////////////
-          packet->AddHeader (removedHeader);
-          NS_LOG_DEBUG ("Update for removed record is: Destination: " << removedHeader.GetDst ()
-                                                                      << " SeqNo:" << removedHeader.GetDstSeqno ()
-                                                                      << " HopCount:" << removedHeader.GetHopCount ());
+          RoutingTableEntry advertised = *i;
+          advertised.SetEntriesChanged (false);
+          m_routingTable.Update (advertised);
         }
-      socket->Send (packet);
-      // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
-      Ipv4Address destination;
-      if (iface.GetMask () == Ipv4Mask::GetOnes ())
+      else if (!fullDump && i->GetHop () != 0)
         {
-          destination = Ipv4Address ("255.255.255.255");
+          continue;
+        }
+      if (i->GetHop () == 0)
+        {
+          RoutingTableEntry ownEntry;
+          dreamHeader.SetDst (m_ipv4->GetAddress (1,0).GetLocal ());
+          dreamHeader.SetDstSeqno (i->GetSeqNo () + 2);
+          dreamHeader.SetHopCount (i->GetHop () + 1);
+          ////////////////Maisha//////////////////
+          m_routingTable.AddMobilityData(m_mainAddress,state.x,state.y,state.speed);
+          ///////////////////////////////
+          m_routingTable.LookupRoute (m_ipv4->GetAddress (1,0).GetBroadcast (),ownEntry);
+          ownEntry.SetSeqNo (dreamHeader.GetDstSeqno ());
+          m_routingTable.Update (ownEntry);
+          updateHeader.AddRecord (dreamHeader);
         }
       else
         {
-          destination = iface.GetBroadcast ();
+          dreamHeader.SetDst (i->GetDestination ());
+          dreamHeader.SetDstSeqno ((i->GetSeqNo ()));
+          dreamHeader.SetHopCount (i->GetHop () + 1);
+          updateHeader.AddRecord (dreamHeader);
         }
-      socket->SendTo (packet, 0, InetSocketAddress (destination, DREAM_PORT));
-      NS_LOG_FUNCTION ("PeriodicUpdate Packet UID is : " << packet->GetUid ());
+      NS_LOG_DEBUG ("Forwarding the update for " << i->GetDestination ());
+      NS_LOG_DEBUG ("Forwarding details are, Destination: " << dreamHeader.GetDst ()
+                                                            << ", SeqNo:" << dreamHeader.GetDstSeqno ()
+                                                            << ", HopCount:" << dreamHeader.GetHopCount ()
+                                                            << ", LifeTime: " << i->GetLifeTime ().As (Time::S));
+    }
+  for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator rmItr = removedAddresses.begin (); rmItr
+       != removedAddresses.end (); ++rmItr)
+    {
+      DreamHeader removedHeader;
+      removedHeader.SetDst (rmItr->second.GetDestination ());
+      removedHeader.SetDstSeqno (rmItr->second.GetSeqNo () + 1);
+      removedHeader.SetHopCount (rmItr->second.GetHop () + 1);
+      updateHeader.AddRecord (removedHeader);
+      NS_LOG_DEBUG ("Update for removed record is: Destination: " << removedHeader.GetDst ()
+                                                                  << " SeqNo:" << removedHeader.GetDstSeqno ()
+                                                                  << " HopCount:" << removedHeader.GetHopCount ());
     }
+  SendUpdate (updateHeader);
+  ScheduleRouteExpiry ();
   m_periodicUpdateTimer.Schedule (m_periodicUpdateInterval + MicroSeconds (25 * m_uniformRandomVariable->GetInteger (0,1000)));
 }
 
@@ -1044,6 +1180,7 @@ DreamRoutingProtocol::SetIpv4 (Ptr<Ipv4> ipv4)
   NS_ASSERT (ipv4 != 0);
   NS_ASSERT (m_ipv4 == 0);
   m_ipv4 = ipv4;
+  m_mobility = m_ipv4->GetObject<MobilityModel> ();
   // Create lo route. It is asserted that the only one interface up for now is loopback
   NS_ASSERT (m_ipv4->GetNInterfaces () == 1 && m_ipv4->GetAddress (0, 0).GetLocal () == Ipv4Address ("127.0.0.1"));
   m_lo = m_ipv4->GetNetDevice (0);
@@ -1068,6 +1205,7 @@ DreamRoutingProtocol::NotifyInterfaceUp (uint32_t i)
 {
   NS_LOG_FUNCTION (this << m_ipv4->GetAddress (i, 0).GetLocal ()
                         << " interface is up");
+  m_addressGeneration++;
   Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
   Ipv4InterfaceAddress iface = l3->GetAddress (i,0);
   if (iface.GetLocal () == Ipv4Address ("127.0.0.1"))
@@ -1077,15 +1215,13 @@ DreamRoutingProtocol::NotifyInterfaceUp (uint32_t i)
   // Create a socket to listen only on this interface
   Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (),UdpSocketFactory::GetTypeId ());
   NS_ASSERT (socket != 0);
-  socket->SetRecvCallback (MakeCallback (&DreamRoutingProtocol::RecvDream,this));
   socket->BindToNetDevice (l3->GetNetDevice (i));
   socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DREAM_PORT));
   socket->SetAllowBroadcast (true);
   socket->SetAttribute ("IpTtl",UintegerValue (1));
-  m_socketAddresses.insert (std::make_pair (socket,iface));
+  AddSocket (socket, i, iface);
   // Add local broadcast record to the routing table
-  Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (iface.GetLocal ()));
-  RoutingTableEntry rt (/*device=*/ dev, /*dst=*/ iface.GetBroadcast (), /*seqno=*/ 0,/*iface=*/ iface,/*hops=*/ 0,
+  RoutingTableEntry rt (/*device=*/ l3->GetNetDevice (i), /*dst=*/ iface.GetBroadcast (), /*seqno=*/ 0,/*iface=*/ iface,/*hops=*/ 0,
                                     /*next hop=*/ iface.GetBroadcast (), /*lifetime=*/ Simulator::GetMaximumSimulationTime ());
   m_routingTable.AddRoute (rt);
   if (m_mainAddress == Ipv4Address ())
@@ -1098,12 +1234,14 @@ DreamRoutingProtocol::NotifyInterfaceUp (uint32_t i)
 void
 DreamRoutingProtocol::NotifyInterfaceDown (uint32_t i)
 {
+  m_addressGeneration++;
   Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
   Ptr<NetDevice> dev = l3->GetNetDevice (i);
   Ptr<Socket> socket = FindSocketWithInterfaceAddress (m_ipv4->GetAddress (i,0));
   NS_ASSERT (socket);
   socket->Close ();
   m_socketAddresses.erase (socket);
+  UpdateLocalAddresses ();
   if (m_socketAddresses.empty ())
     {
       NS_LOG_LOGIC ("No dream interfaces");
@@ -1111,7 +1249,6 @@ DreamRoutingProtocol::NotifyInterfaceDown (uint32_t i)
       return;
     }
   m_routingTable.DeleteAllRoutesFromInterface (m_ipv4->GetAddress (i,0));
-  m_advRoutingTable.DeleteAllRoutesFromInterface (m_ipv4->GetAddress (i,0));
 }
 
 void
@@ -1119,6 +1256,7 @@ DreamRoutingProtocol::NotifyAddAddress (uint32_t i,
                                    Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << " interface " << i << " address " << address);
+  m_addressGeneration++;
   Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
   if (!l3->IsUp (i))
     {
@@ -1134,14 +1272,12 @@ DreamRoutingProtocol::NotifyAddAddress (uint32_t i,
         }
       Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (),UdpSocketFactory::GetTypeId ());
       NS_ASSERT (socket != 0);
-      socket->SetRecvCallback (MakeCallback (&DreamRoutingProtocol::RecvDream,this));
       // Bind to any IP address so that broadcasts can be received
       socket->BindToNetDevice (l3->GetNetDevice (i));
       socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DREAM_PORT));
       socket->SetAllowBroadcast (true);
-      m_socketAddresses.insert (std::make_pair (socket,iface));
-      Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (iface.GetLocal ()));
-      RoutingTableEntry rt (/*device=*/ dev, /*dst=*/ iface.GetBroadcast (),/*seqno=*/ 0, /*iface=*/ iface,/*hops=*/ 0,
+      AddSocket (socket, i, iface);
+      RoutingTableEntry rt (/*device=*/ l3->GetNetDevice (i), /*dst=*/ iface.GetBroadcast (),/*seqno=*/ 0, /*iface=*/ iface,/*hops=*/ 0,
                                         /*next hop=*/ iface.GetBroadcast (), /*lifetime=*/ Simulator::GetMaximumSimulationTime ());
       m_routingTable.AddRoute (rt);
     }
@@ -1151,9 +1287,12 @@ void
 DreamRoutingProtocol::NotifyRemoveAddress (uint32_t i,
                                       Ipv4InterfaceAddress address)
 {
+  m_addressGeneration++;
   Ptr<Socket> socket = FindSocketWithInterfaceAddress (address);
   if (socket)
     {
+      // The context of the socket goes with it
+      socket->Close ();
       m_socketAddresses.erase (socket);
       Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
       if (l3->GetNAddresses (i))
@@ -1162,23 +1301,23 @@ DreamRoutingProtocol::NotifyRemoveAddress (uint32_t i,
           // Create a socket to listen only on this interface
           Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (),UdpSocketFactory::GetTypeId ());
           NS_ASSERT (socket != 0);
-          socket->SetRecvCallback (MakeCallback (&DreamRoutingProtocol::RecvDream,this));
           // Bind to any IP address so that broadcasts can be received
           socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DREAM_PORT));
           socket->SetAllowBroadcast (true);
-          m_socketAddresses.insert (std::make_pair (socket,iface));
+          AddSocket (socket, i, iface);
         }
+      UpdateLocalAddresses ();
     }
 }
 
 Ptr<Socket>
 DreamRoutingProtocol::FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr) const
 {
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j
+  for (std::map<Ptr<Socket>, SocketContext>::const_iterator j = m_socketAddresses.begin (); j
        != m_socketAddresses.end (); ++j)
     {
       Ptr<Socket> socket = j->first;
-      Ipv4InterfaceAddress iface = j->second;
+      Ipv4InterfaceAddress iface = j->second.iface;
       if (iface == addr)
         {
           return socket;
@@ -1188,6 +1327,56 @@ DreamRoutingProtocol::FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr)
   return socket;
 }
 
+void
+DreamRoutingProtocol::AddSocket (Ptr<Socket> socket, uint32_t i, Ipv4InterfaceAddress iface)
+{
+  // Map nodes do not move, so the context stays put until the socket is erased
+  SocketContext & context = m_socketAddresses[socket];
+  context.protocol = this;
+  context.interface = i;
+  context.device = m_ipv4->GetNetDevice (i);
+  context.iface = iface;
+  socket->SetRecvCallback (MakeCallback (&SocketContext::Recv, &context));
+  UpdateLocalAddresses ();
+}
+
+void
+DreamRoutingProtocol::UpdateLocalAddresses ()
+{
+  m_localAddresses.clear ();
+  m_localBroadcasts.clear ();
+  for (std::map<Ptr<Socket>, SocketContext>::const_iterator j = m_socketAddresses.begin (); j
+       != m_socketAddresses.end (); ++j)
+    {
+      Ipv4InterfaceAddress iface = j->second.iface;
+      m_localAddresses.push_back (iface.GetLocal ());
+      m_localBroadcasts.push_back (std::make_pair (j->second.interface, iface.GetBroadcast ()));
+    }
+  std::sort (m_localAddresses.begin (), m_localAddresses.end ());
+  std::sort (m_localBroadcasts.begin (), m_localBroadcasts.end ());
+}
+
+bool
+DreamRoutingProtocol::IsLocalAddress (Ipv4Address address) const
+{
+  return std::binary_search (m_localAddresses.begin (), m_localAddresses.end (), address);
+}
+
+bool
+DreamRoutingProtocol::IsLocalBroadcast (Ipv4Address dst, int32_t iif) const
+{
+  // The limited broadcast address is local to any dream interface, and the
+  // interface index sorts first: find the first entry of the input interface
+  std::vector<std::pair<int32_t, Ipv4Address> >::const_iterator i =
+    std::lower_bound (m_localBroadcasts.begin (), m_localBroadcasts.end (),
+                      std::make_pair (iif, dst.IsBroadcast () ? Ipv4Address ((uint32_t) 0) : dst));
+  if (i == m_localBroadcasts.end () || i->first != iif)
+    {
+      return false;
+    }
+  return dst.IsBroadcast () || i->second == dst;
+}
+
 void
 DreamRoutingProtocol::Send (Ptr<Ipv4Route> route,
                        Ptr<const Packet> packet,
@@ -1206,41 +1395,74 @@ DreamRoutingProtocol::Drop (Ptr<const Packet> packet,
 {
   NS_LOG_DEBUG (m_mainAddress << " drop packet " << packet->GetUid () << " to "
                               << header.GetDestination () << " from queue. Error " << err);
+  RecordDrop (packet, header, DROP_NO_ROUTE);
 }
 
 void
-DreamRoutingProtocol::LookForQueuedPackets ()
+DreamRoutingProtocol::RecordDrop (Ptr<const Packet> packet,
+                             const Ipv4Header & header,
+                             DropReason reason)
 {
-  NS_LOG_FUNCTION (this);
-  Ptr<Ipv4Route> route;
-  std::map<Ipv4Address, RoutingTableEntry> allRoutes;
-  m_routingTable.GetListOfAllRoutes (allRoutes);
-  for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = allRoutes.begin (); i != allRoutes.end (); ++i)
+  m_statistics.drops[reason]++;
+  m_dropTrace (packet, header, reason);
+}
+
+void
+DreamRoutingProtocol::QueueDrop (QueueEntry const & entry, DropReason reason)
+{
+  RecordDrop (entry.GetPacket (), entry.GetIpv4Header (), reason);
+  UpdateQueueOccupancy ();
+}
+
+void
+DreamRoutingProtocol::QueueReject (QueueEntry const & entry, EnqueueRejectReason reason)
+{
+  m_statistics.rejects[reason]++;
+  m_enqueueRejectTrace (entry.GetPacket (), entry.GetIpv4Header (), reason);
+}
+
+void
+DreamRoutingProtocol::UpdateQueueOccupancy ()
+{
+  m_queueOccupancy = m_queue.GetSize ();
+  m_statistics.maxOccupancy = std::max (m_statistics.maxOccupancy, m_queue.GetSize ());
+}
+
+void
+DreamRoutingProtocol::LookForQueuedPackets (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  if (!m_queue.Find (dst))
     {
-      RoutingTableEntry rt;
-      rt = i->second;
-      if (m_queue.Find (rt.GetDestination ()))
-        {
-          if (rt.GetHop () == 1)
-            {
-              route = rt.GetRoute ();
-              NS_LOG_LOGIC ("A route exists from " << route->GetSource ()
-                                                   << " to neighboring destination "
-                                                   << route->GetDestination ());
-              NS_ASSERT (route != 0);
-            }
-          else
-            {
-              RoutingTableEntry newrt;
-              m_routingTable.LookupRoute (rt.GetNextHop (),newrt);
-              route = newrt.GetRoute ();
-              NS_LOG_LOGIC ("A route exists from " << route->GetSource ()
-                                                   << " to destination " << route->GetDestination () << " via "
-                                                   << rt.GetNextHop ());
-              NS_ASSERT (route != 0);
-            }
-          SendPacketFromQueue (rt.GetDestination (),route);
-        }
+      return;
+    }
+  Ptr<Ipv4Route> route = m_routingTable.ResolveRoute (dst);
+  if (route == 0)
+    {
+      return;
+    }
+  NS_LOG_LOGIC ("A route exists from " << route->GetSource ()
+                                       << " to destination " << dst << " via "
+                                       << route->GetGateway ());
+  SendPacketFromQueue (dst,route);
+}
+
+void
+DreamRoutingProtocol::DrainQueue (std::vector<Ipv4Address> const & resolved)
+{
+  if (!EnableBuffering || m_queue.GetSize () == 0)
+    {
+      return;
+    }
+  std::vector<Ipv4Address> dsts (resolved);
+  for (std::vector<Ipv4Address>::const_iterator i = resolved.begin (); i != resolved.end (); ++i)
+    {
+      // The routes through this destination may only now resolve
+      m_routingTable.GetDestinationsWithNextHop (*i, dsts);
+    }
+  for (std::vector<Ipv4Address>::const_iterator i = dsts.begin (); i != dsts.end (); ++i)
+    {
+      LookForQueuedPackets (*i);
     }
 }
 
@@ -1248,10 +1470,11 @@ void
 DreamRoutingProtocol::SendPacketFromQueue (Ipv4Address dst,
                                       Ptr<Ipv4Route> route)
 {
-  NS_LOG_DEBUG (m_mainAddress << " is sending a queued packet to destination " << dst);
+  NS_LOG_DEBUG (m_mainAddress << " is sending the queued packets to destination " << dst);
   QueueEntry queueEntry;
-  if (m_queue.Dequeue (dst,queueEntry))
+  while (m_queue.Dequeue (dst,queueEntry))
     {
+      UpdateQueueOccupancy ();
       DeferredRouteOutputTag tag;
       Ptr<Packet> p = ConstCast<Packet> (queueEntry.GetPacket ());
       if (p->RemovePacketTag (tag))
@@ -1259,29 +1482,68 @@ DreamRoutingProtocol::SendPacketFromQueue (Ipv4Address dst,
           if (tag.oif != -1 && tag.oif != m_ipv4->GetInterfaceForDevice (route->GetOutputDevice ()))
             {
               NS_LOG_DEBUG ("Output device doesn't match. Dropped.");
-              return;
+              RecordDrop (p, queueEntry.GetIpv4Header (), DROP_INTERFACE_MISMATCH);
+              continue;
             }
         }
+      Time sojourn = Simulator::Now () - queueEntry.GetEnqueueTime ();
+      m_statistics.dequeued++;
+      m_statistics.totalSojourn += sojourn;
+      m_statistics.maxSojourn = std::max (m_statistics.maxSojourn, sojourn);
+      m_queueSojournTrace (p, sojourn);
       UnicastForwardCallback ucb = queueEntry.GetUnicastForwardCallback ();
       Ipv4Header header = queueEntry.GetIpv4Header ();
       header.SetSource (route->GetSource ());
       header.SetTtl (header.GetTtl () + 1); // compensate extra TTL decrement by fake loopback routing
       ucb (route,p,header);
-      if (m_queue.GetSize () != 0 && m_queue.Find (dst))
-        {
-          Simulator::Schedule (MilliSeconds (m_uniformRandomVariable->GetInteger (0,100)),
-                               &DreamRoutingProtocol::SendPacketFromQueue,this,dst,route);
-        }
     }
 }
 
+void
+DreamRoutingProtocol::PurgeRoutes ()
+{
+  std::map<Ipv4Address, RoutingTableEntry> removedAddresses;
+  m_statistics.failovers += m_routingTable.Purge (removedAddresses);
+  std::vector<Ipv4Address> failedOver;
+  m_routingTable.TakeFailedOver (failedOver);
+  DrainQueue (failedOver);
+  for (std::map<Ipv4Address, RoutingTableEntry>::iterator rmItr = removedAddresses.begin ();
+       rmItr != removedAddresses.end (); ++rmItr)
+    {
+      rmItr->second.SetEntriesChanged (true);
+      rmItr->second.SetSeqNo (rmItr->second.GetSeqNo () + 1);
+      m_routingTable.AddAdvertisement (rmItr->second);
+    }
+  if (!removedAddresses.empty ())
+    {
+      ScheduleTriggeredUpdate (MicroSeconds (m_uniformRandomVariable->GetInteger (0,1000)));
+    }
+  ScheduleRouteExpiry ();
+}
+
+void
+DreamRoutingProtocol::ScheduleRouteExpiry ()
+{
+  Time next;
+  if (!m_routingTable.GetNextExpiry (next))
+    {
+      return;
+    }
+  // Purge only removes a route once its expiry time has passed
+  Time delay = std::max (next - Simulator::Now (), Seconds (0)) + NanoSeconds (1);
+  if (m_routeExpiryTimer.IsRunning () && m_routeExpiryTimer.GetDelayLeft () <= delay)
+    {
+      return;
+    }
+  m_routeExpiryTimer.Cancel ();
+  m_routeExpiryTimer.Schedule (delay);
+}
+
 Time
-DreamRoutingProtocol::GetSettlingTime (Ipv4Address address)
+DreamRoutingProtocol::GetSettlingTime (RoutingTableEntry const & mainrt)
 {
-  NS_LOG_FUNCTION ("Calculating the settling time for " << address);
-  RoutingTableEntry mainrt;
+  NS_LOG_FUNCTION ("Calculating the settling time for " << mainrt.GetDestination ());
   Time weightedTime;
-  m_routingTable.LookupRoute (address,mainrt);
   if (EnableWST)
     {
       if (mainrt.GetSettlingTime () == Seconds (0))
@@ -1305,28 +1567,15 @@ void
 DreamRoutingProtocol::MergeTriggerPeriodicUpdates ()
 {
   NS_LOG_FUNCTION ("Merging advertised table changes with main table before sending out periodic update");
-  std::map<Ipv4Address, RoutingTableEntry> allRoutes;
-  m_advRoutingTable.GetListOfAllRoutes (allRoutes);
-  if (allRoutes.size () > 0)
+  std::vector<RoutingTableEntry> ready;
+  m_routingTable.TakeChangedRoutes (ready);
+  for (std::vector<RoutingTableEntry>::iterator i = ready.begin (); i != ready.end (); ++i)
     {
-      for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = allRoutes.begin (); i != allRoutes.end (); ++i)
+      if (!(i->GetSeqNo () % 2))
         {
-          RoutingTableEntry advEntry = i->second;
-          if ((advEntry.GetEntriesChanged () == true) && (!m_advRoutingTable.AnyRunningEvent (advEntry.GetDestination ())))
-            {
-              if (!(advEntry.GetSeqNo () % 2))
-                {
-                  advEntry.SetFlag (VALID);
-                  advEntry.SetEntriesChanged (false);
-                  m_routingTable.Update (advEntry);
-                  NS_LOG_DEBUG ("Merged update for " << advEntry.GetDestination () << " with main routing Table");
-                }
-              m_advRoutingTable.DeleteRoute (advEntry.GetDestination ());
-            }
-          else
-            {
-              NS_LOG_DEBUG ("Event currently running. Cannot Merge Routing Tables");
-            }
+          i->SetEntriesChanged (EnableIncrementalDump);
+          m_routingTable.Update (*i);
+          NS_LOG_DEBUG ("Merged update for " << i->GetDestination () << " with main routing Table");
         }
     }
 }
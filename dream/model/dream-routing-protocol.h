@@ -42,10 +42,44 @@
 #include "ns3/ipv4-interface.h"
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/output-stream-wrapper.h"
+#include "ns3/mobility-model.h"
+#include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
 
 namespace ns3 {
 namespace dream {
 
+/**
+ * \ingroup dream
+ * \brief Per-node counters of the data packets DREAM drops, refuses to buffer and buffers
+ */
+struct DreamStatistics
+{
+  /// c-tor, all counters are zero
+  DreamStatistics ();
+  /**
+   * Add the counters of another node
+   * \param o the counters to add
+   * \return this
+   */
+  DreamStatistics & operator+= (DreamStatistics const & o);
+  /**
+   * Print the counters on a single line
+   * \param os the output stream
+   */
+  void Print (std::ostream & os) const;
+
+  uint64_t drops[DROP_REASON_COUNT]; ///< Packets dropped, per DropReason
+  uint64_t rejects[REJECT_REASON_COUNT]; ///< Packets the queue refused, per EnqueueRejectReason
+  uint64_t enqueued; ///< Packets buffered until a route is found
+  uint64_t dequeued; ///< Buffered packets sent once a route was found
+  uint32_t maxOccupancy; ///< Highest number of packets buffered at the same time
+  Time totalSojourn; ///< Sum of the time the dequeued packets were buffered
+  Time maxSojourn; ///< Longest time a dequeued packet was buffered
+  uint64_t failovers; ///< Routes moved to a backup next hop when their next hop went away
+  uint64_t malformedUpdates; ///< DREAM updates discarded as shorter than their record count
+};
+
 /**
  * \ingroup dream
  * \brief dream routing protocol.
@@ -60,6 +94,28 @@ public:
   static TypeId GetTypeId (void);
   static const uint32_t DREAM_PORT;
 
+  /**
+   * TracedCallback signature for data packets dropped by DREAM
+   * \param [in] packet the packet
+   * \param [in] header the IPv4 header of the packet
+   * \param [in] reason the reason for the drop
+   */
+  typedef void (* DropTracedCallback)(Ptr<const Packet> packet, const Ipv4Header & header, DropReason reason);
+  /**
+   * TracedCallback signature for data packets the queue refuses to buffer
+   * \param [in] packet the packet
+   * \param [in] header the IPv4 header of the packet
+   * \param [in] reason the reason for the refusal
+   */
+  typedef void (* EnqueueRejectTracedCallback)(Ptr<const Packet> packet, const Ipv4Header & header,
+                                               EnqueueRejectReason reason);
+  /**
+   * TracedCallback signature for buffered data packets leaving the queue to be sent
+   * \param [in] packet the packet
+   * \param [in] sojourn the time the packet was buffered
+   */
+  typedef void (* SojournTracedCallback)(Ptr<const Packet> packet, Time sojourn);
+
   /// c-tor
   DreamRoutingProtocol ();
   virtual
@@ -130,7 +186,15 @@ public:
    * \return the number of stream indices assigned by this model
    */
   int64_t AssignStreams (int64_t stream);
-  
+
+  /**
+   * Get the counters of the data packets dropped, refused and buffered by this node
+   * \returns the counters
+   */
+  const DreamStatistics & GetStatistics () const;
+  /// Reset the counters of this node
+  void ResetStatistics ();
+
 
 private:
   // Protocol parameters.
@@ -148,21 +212,62 @@ private:
   Ipv4Address m_mainAddress;
   /// IP protocol
   Ptr<Ipv4> m_ipv4;
-  /// Raw socket per each IP interface, map socket -> iface address (IP + mask)
-  std::map<Ptr<Socket>, Ipv4InterfaceAddress> m_socketAddresses;
+  /// Mobility model aggregated to the node, looked up once
+  Ptr<MobilityModel> m_mobility;
+  /// Receiver side state of a dream socket, resolved once when the socket is opened
+  struct SocketContext
+  {
+    DreamRoutingProtocol *protocol; ///< Protocol the socket belongs to
+    int32_t interface; ///< Index of the interface the socket listens on
+    Ptr<NetDevice> device; ///< Device of the interface
+    Ipv4InterfaceAddress iface; ///< Interface address, giving the local and the broadcast address
+    /**
+     * Receive callback of the socket
+     * \param socket the socket
+     */
+    void
+    Recv (Ptr<Socket> socket)
+    {
+      protocol->RecvDream (socket, *this);
+    }
+  };
+  /// Raw socket per each IP interface, map socket -> context of the interface
+  std::map<Ptr<Socket>, SocketContext> m_socketAddresses;
+  /// Local addresses of the dream interfaces, sorted, rebuilt whenever m_socketAddresses changes
+  std::vector<Ipv4Address> m_localAddresses;
+  /// Interface index and subnet broadcast address of the dream interfaces, sorted
+  std::vector<std::pair<int32_t, Ipv4Address> > m_localBroadcasts;
+  /// A forwarding decision of RouteInput, reused for the following packets to the same destination
+  struct ForwardingCacheEntry
+  {
+    Ipv4Address destination; ///< Destination of the packets
+    Ptr<const NetDevice> device; ///< Device the packets came in on
+    int32_t interface; ///< Index of the input interface
+    uint64_t generation; ///< Routing table generation the route was resolved in
+    uint64_t addressGeneration; ///< Address generation in which the destination was found not to be local
+    Ptr<Ipv4Route> route; ///< Route the packets are forwarded on, 0 if the entry is unused
+  };
+  /// Number of entries of the forwarding cache, a power of two
+  static const uint32_t FORWARDING_CACHE_SIZE;
+  /// Forwarding cache of RouteInput, indexed by a hash of the destination
+  std::vector<ForwardingCacheEntry> m_forwardingCache;
+  /// Incremented whenever an interface or an address of the node changes
+  uint64_t m_addressGeneration;
   /// Loopback device used to defer route requests until a route is found
   Ptr<NetDevice> m_lo;
-  /// Main Routing table for the node
+  /// Routing table for the node, holding the routes along with the advertisements waiting to be sent
   RoutingTable m_routingTable;
-  /// Advertised Routing table for the node
-  RoutingTable m_advRoutingTable;
   /// The maximum number of packets that we allow a routing protocol to buffer.
   uint32_t m_maxQueueLen;
   /// The maximum number of packets that we allow per destination to buffer.
   uint32_t m_maxQueuedPacketsPerDst;
   /// The maximum period of time that a routing protocol is allowed to buffer a packet for.
   Time m_maxQueueTime;
-  /// A "drop front on full" queue used by the routing layer to buffer packets to which it does not have a route.
+  /// The maximum number of bytes that we allow a routing protocol to buffer, 0 for no limit.
+  uint32_t m_maxQueueBytes;
+  /// What the queue does with a packet that does not fit.
+  QueuePolicy m_queuePolicy;
+  /// A queue used by the routing layer to buffer packets to which it does not have a route.
   PacketQueue m_queue;
   /// Flag that is used to enable or disable buffering
   bool EnableBuffering;
@@ -175,10 +280,36 @@ private:
   bool EnableRouteAggregation;
   /// Parameter that holds the route aggregation time interval
   Time m_routeAggregationTime;
+  /// Minimum time between two triggered updates
+  Time m_minTriggeredUpdateInterval;
+  /// Flag that is used to enable incremental dumps. A periodic update then only carries the routes changed
+  /// since the previous one, except for every 'FullDumpPeriod'th update which carries the whole table.
+  bool EnableIncrementalDump;
+  /// Number of periodic updates between full dumps of the routing table
+  uint32_t m_fullDumpPeriod;
+  /// Flag that is used to enable backup next hops. Routes then fall over to a neighbour that advertised as
+  /// good a metric when their next hop goes away.
+  bool EnableBackupNextHops;
+  /// Flag that is used to enable geographic next hops. Among the neighbours that advertise the same
+  /// sequence number and metric for a destination, one in the expected-zone cone toward it is used, the
+  /// one closest to its last known location first.
+  bool EnableGeographicNextHop;
+  /// Side of the grid cells of the location table, in meters
+  double m_locationCellSize;
   /// Unicast callback for own packets
   UnicastForwardCallback m_scb;
   /// Error callback for own packets
   ErrorCallback m_ecb;
+  /// Counters of the data packets dropped, refused and buffered
+  DreamStatistics m_statistics;
+  /// Trace of the data packets dropped
+  TracedCallback<Ptr<const Packet>, const Ipv4Header &, DropReason> m_dropTrace;
+  /// Trace of the data packets the queue refused
+  TracedCallback<Ptr<const Packet>, const Ipv4Header &, EnqueueRejectReason> m_enqueueRejectTrace;
+  /// Number of packets buffered
+  TracedValue<uint32_t> m_queueOccupancy;
+  /// Trace of the time buffered packets spent in the queue
+  TracedCallback<Ptr<const Packet>, Time> m_queueSojournTrace;
 
 private:
   /// Start protocol operation
@@ -193,13 +324,25 @@ private:
    */
   void
   DeferredRouteOutput (Ptr<const Packet> p, const Ipv4Header & header, UnicastForwardCallback ucb, ErrorCallback ecb);
-  /// Look for any queued packets to send them out
+  /**
+   * Send out the packets queued for a destination if there is a route to it.
+   * Called through DrainQueue when an update installs or repairs a route.
+   * \param dst - destination address
+   */
   void
-  LookForQueuedPackets (void);
+  LookForQueuedPackets (Ipv4Address dst);
   /**
-   * Send packet from queue
-   * \param dst - destination address to which we are sending the packet to
-   * \param route - route identified for this packet
+   * Send out the packets queued for destinations whose route was installed,
+   * refreshed or moved to a backup next hop, and for the destinations reached
+   * through them.
+   * \param resolved the destinations
+   */
+  void
+  DrainQueue (std::vector<Ipv4Address> const & resolved);
+  /**
+   * Send all the packets queued for a destination
+   * \param dst - destination address to which we are sending the packets to
+   * \param route - route identified for these packets
    */
   void
   SendPacketFromQueue (Ipv4Address dst, Ptr<Ipv4Route> route);
@@ -210,14 +353,41 @@ private:
    */
   Ptr<Socket>
   FindSocketWithInterfaceAddress (Ipv4InterfaceAddress iface) const;
+  /**
+   * Add a socket to m_socketAddresses and have it deliver to RecvDream through its context
+   * \param socket the socket
+   * \param i the index of the interface the socket listens on
+   * \param iface the address of the interface
+   */
+  void
+  AddSocket (Ptr<Socket> socket, uint32_t i, Ipv4InterfaceAddress iface);
+  /// Rebuild the local and broadcast address sets from m_socketAddresses
+  void
+  UpdateLocalAddresses ();
+  /**
+   * Check whether an address is the local address of one of the dream interfaces
+   * \param address the address
+   * \return true if the address is ours
+   */
+  bool
+  IsLocalAddress (Ipv4Address address) const;
+  /**
+   * Check whether a destination is a broadcast address of the dream interface a packet came in on
+   * \param dst the destination of the packet
+   * \param iif the index of the input interface
+   * \return true if the packet is a broadcast on that interface
+   */
+  bool
+  IsLocalBroadcast (Ipv4Address dst, int32_t iif) const;
 
   // Receive dream control packets
   /**
    * Receive and process dream control packet
    * \param socket the socket for receiving dream control packets
+   * \param context the interface the socket listens on
    */
   void
-  RecvDream (Ptr<Socket> socket);
+  RecvDream (Ptr<Socket> socket, SocketContext const & context);
   /// Send packet
   void
   Send (Ptr<Ipv4Route>, Ptr<const Packet>, const Ipv4Header &);
@@ -232,27 +402,93 @@ private:
   LoopbackRoute (const Ipv4Header & header, Ptr<NetDevice> oif) const;
   /**
    * Get settlingTime for a destination
-   * \param dst - destination address
-   * \return settlingTime for the destination if found
+   * \param mainrt - the current route to the destination
+   * \return settlingTime for the destination
    */
   Time
-  GetSettlingTime (Ipv4Address dst);
+  GetSettlingTime (RoutingTableEntry const & mainrt);
+  /// Location of this node advertised in the sender block of an update
+  struct LocalState
+  {
+    uint32_t x; ///< Position in x axis
+    uint32_t y; ///< Position in y axis
+    float speed; ///< Speed
+  };
+  /**
+   * Sample the mobility model once for an update. The result is shared by
+   * every record and every interface of the update.
+   * \return the location of this node
+   */
+  LocalState
+  GetLocalState ();
+  /**
+   * Broadcast an update on every interface. The update is serialized once
+   * and every interface sends a copy-on-write copy of the same packet.
+   * \param updateHeader the update
+   */
+  void
+  SendUpdate (const DreamUpdateHeader & updateHeader);
   /// Sends trigger update from a node
   void
   SendTriggeredUpdate ();
+  /**
+   * Send a triggered update after the given delay. A node has at most one triggered
+   * update pending: if one is already due earlier it carries the new changes as well.
+   * Triggered updates are at least MinTriggeredUpdateInterval apart.
+   * \param delay the delay
+   */
+  void
+  ScheduleTriggeredUpdate (Time delay);
   /// Broadcasts the entire routing table for every PeriodicUpdateInterval
   void
   SendPeriodicUpdate ();
   /// Merge periodic updates
   void
   MergeTriggerPeriodicUpdates ();
+  /// Remove the expired routes, advertise their removal and wait for the next expiry
+  void
+  PurgeRoutes ();
+  /// Schedule the route expiry timer for the earliest route expiry
+  void
+  ScheduleRouteExpiry ();
   /// Notify that packet is dropped for some reason
   void
   Drop (Ptr<const Packet>, const Ipv4Header &, Socket::SocketErrno);
+  /**
+   * Count and trace a dropped data packet
+   * \param packet the packet
+   * \param header the IPv4 header of the packet
+   * \param reason the reason for the drop
+   */
+  void
+  RecordDrop (Ptr<const Packet> packet, const Ipv4Header & header, DropReason reason);
+  /**
+   * Drop callback of the queue
+   * \param entry the dropped entry
+   * \param reason the reason for the drop
+   */
+  void
+  QueueDrop (QueueEntry const & entry, DropReason reason);
+  /**
+   * Reject callback of the queue
+   * \param entry the refused entry
+   * \param reason the reason for the refusal
+   */
+  void
+  QueueReject (QueueEntry const & entry, EnqueueRejectReason reason);
+  /// Update the traced queue occupancy after the queue changed
+  void
+  UpdateQueueOccupancy ();
   /// Timer to trigger periodic updates from a node
   Timer m_periodicUpdateTimer;
-  /// Timer used by the trigger updates in case of Weighted Settling Time is used
+  /// Number of periodic updates sent so far
+  uint32_t m_periodicUpdateCount;
+  /// Timer of the pending triggered update, including the ones waiting for a Weighted Settling Time
   Timer m_triggeredExpireTimer;
+  /// Time the last triggered update was sent
+  Time m_lastTriggeredUpdate;
+  /// Timer removing the expired routes from the routing table
+  Timer m_routeExpiryTimer;
 
   /// Provides uniform random variables.
   Ptr<UniformRandomVariable> m_uniformRandomVariable;
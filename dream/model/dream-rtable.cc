@@ -31,6 +31,7 @@
 #include "dream-rtable.h"
 #include "ns3/simulator.h"
 #include <iomanip>
+#include <algorithm>
 #include "ns3/log.h"
 
 namespace ns3 {
@@ -38,6 +39,16 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("DreamRoutingTable");
 
 namespace dream {
+RoutingTableEntry::RoutingTableEntry ()
+  : m_seqNo (0),
+    m_hops (0),
+    m_lifeTime (Simulator::Now ()),
+    m_flag (VALID),
+    m_settlingTime (Simulator::Now ()),
+    m_entriesChanged (false)
+{
+}
+
 RoutingTableEntry::RoutingTableEntry (Ptr<NetDevice> dev,
                                       Ipv4Address dst,
                                       uint32_t seqNo,
@@ -64,24 +75,227 @@ RoutingTableEntry::RoutingTableEntry (Ptr<NetDevice> dev,
 RoutingTableEntry::~RoutingTableEntry ()
 {
 }
+const uint32_t RoutingTable::EMPTY_SLOT;
+const uint32_t DestinationRecord::MAX_BACKUPS;
+
+/// Matches the backup next hops through a given neighbour
+struct IsBackupThrough
+{
+  /**
+   * c-tor
+   * \param nextHop the neighbour
+   */
+  IsBackupThrough (Ipv4Address nextHop)
+    : m_nextHop (nextHop)
+  {
+  }
+  /**
+   * \param backup a backup next hop
+   * \return true if the backup goes through the neighbour
+   */
+  bool
+  operator() (BackupNextHop const & backup) const
+  {
+    return backup.nextHop == m_nextHop;
+  }
+  Ipv4Address m_nextHop; ///< the neighbour
+};
+
 RoutingTable::RoutingTable ()
+  : m_routeCount (0),
+    m_slots (16, EMPTY_SLOT),
+    m_slotMask (15),
+    m_snapshotStale (false),
+    m_generation (0)
+{
+}
+
+uint32_t
+RoutingTable::FindSlot (Ipv4Address dst) const
+{
+  for (uint32_t slot = HomeSlot (dst); m_slots[slot] != EMPTY_SLOT; slot = (slot + 1) & m_slotMask)
+    {
+      if (m_records[m_slots[slot]].m_destination == dst)
+        {
+          return slot;
+        }
+    }
+  return EMPTY_SLOT;
+}
+
+void
+RoutingTable::EraseSlot (uint32_t slot)
+{
+  uint32_t pos = m_slots[slot];
+  // Backward-shift deletion keeps every probe sequence free of holes
+  uint32_t hole = slot;
+  for (uint32_t next = (hole + 1) & m_slotMask; m_slots[next] != EMPTY_SLOT; next = (next + 1) & m_slotMask)
+    {
+      uint32_t home = HomeSlot (m_records[m_slots[next]].m_destination);
+      if (((next - home) & m_slotMask) >= ((next - hole) & m_slotMask))
+        {
+          m_slots[hole] = m_slots[next];
+          hole = next;
+        }
+    }
+  m_slots[hole] = EMPTY_SLOT;
+  DestinationRecord & record = m_records[pos];
+  if (record.m_hasRoute)
+    {
+      UnlinkNextHop (record.m_route.GetNextHop (), record.m_destination);
+      m_routeCount--;
+      m_snapshotStale = true;
+      m_generation++;
+    }
+  if (record.m_hasAdvertisement)
+    {
+      m_pendingAdvertisements.erase (record.m_destination);
+    }
+  // Fill the gap in the record array with the last record
+  uint32_t last = m_records.size () - 1;
+  if (pos != last)
+    {
+      m_slots[FindSlot (m_records[last].m_destination)] = pos;
+      m_records[pos] = m_records[last];
+    }
+  m_records.pop_back ();
+}
+
+void
+RoutingTable::RemoveRoute (uint32_t slot)
+{
+  DestinationRecord & record = m_records[m_slots[slot]];
+  if (!record.m_hasAdvertisement)
+    {
+      EraseSlot (slot);
+      return;
+    }
+  UnlinkNextHop (record.m_route.GetNextHop (), record.m_destination);
+  record.m_hasRoute = false;
+  record.m_nBackups = 0;
+  m_routeCount--;
+  m_snapshotStale = true;
+  m_generation++;
+}
+
+void
+RoutingTable::RemoveAdvertisement (uint32_t slot)
+{
+  DestinationRecord & record = m_records[m_slots[slot]];
+  if (!record.m_hasRoute)
+    {
+      EraseSlot (slot);
+      return;
+    }
+  m_pendingAdvertisements.erase (record.m_destination);
+  record.m_hasAdvertisement = false;
+  record.m_settlingDeadline = Time ();
+}
+
+void
+RoutingTable::Rehash (uint32_t slots)
+{
+  m_slots.assign (slots, EMPTY_SLOT);
+  m_slotMask = slots - 1;
+  for (uint32_t pos = 0; pos < m_records.size (); ++pos)
+    {
+      uint32_t slot = HomeSlot (m_records[pos].m_destination);
+      while (m_slots[slot] != EMPTY_SLOT)
+        {
+          slot = (slot + 1) & m_slotMask;
+        }
+      m_slots[slot] = pos;
+    }
+}
+
+void
+RoutingTable::Clear ()
+{
+  m_records.clear ();
+  m_routeCount = 0;
+  m_snapshotStale = true;
+  m_generation++;
+  m_slots.assign (m_slots.size (), EMPTY_SLOT);
+  m_expiryQueue.clear ();
+  m_nextHopIndex.clear ();
+  m_pendingAdvertisements.clear ();
+  m_failedOver.clear ();
+}
+
+void
+RoutingTable::Setholddowntime (Time t)
+{
+  m_holddownTime = t;
+  RebuildExpiryQueue ();
+}
+
+void
+RoutingTable::ScheduleExpiry (RoutingTableEntry const & rt)
+{
+  if (rt.GetHop () == 0)
+    {
+      return;
+    }
+  // Refreshed routes leave their old deadline behind; drop those once they outnumber the live ones
+  if (m_expiryQueue.size () > 2 * m_routeCount + 64)
+    {
+      RebuildExpiryQueue ();
+    }
+  m_expiryQueue.push_back (std::make_pair (GetExpiryTime (rt), rt.GetDestination ()));
+  std::push_heap (m_expiryQueue.begin (), m_expiryQueue.end (), std::greater<std::pair<Time, Ipv4Address> > ());
+}
+
+void
+RoutingTable::RebuildExpiryQueue ()
+{
+  m_expiryQueue.clear ();
+  for (std::vector<DestinationRecord>::const_iterator i = m_records.begin (); i != m_records.end (); ++i)
+    {
+      if (i->m_hasRoute && i->m_route.GetHop () > 0)
+        {
+          m_expiryQueue.push_back (std::make_pair (GetExpiryTime (i->m_route), i->m_destination));
+        }
+    }
+  std::make_heap (m_expiryQueue.begin (), m_expiryQueue.end (), std::greater<std::pair<Time, Ipv4Address> > ());
+}
+
+void
+RoutingTable::LinkNextHop (Ipv4Address nextHop, Ipv4Address dst)
+{
+  m_nextHopIndex[nextHop].push_back (dst);
+}
+
+void
+RoutingTable::UnlinkNextHop (Ipv4Address nextHop, Ipv4Address dst)
 {
+  std::unordered_map<Ipv4Address, std::vector<Ipv4Address>, Ipv4AddressHash>::iterator i = m_nextHopIndex.find (nextHop);
+  if (i == m_nextHopIndex.end ())
+    {
+      return;
+    }
+  std::vector<Ipv4Address> & dsts = i->second;
+  std::vector<Ipv4Address>::iterator j = std::find (dsts.begin (), dsts.end (), dst);
+  if (j != dsts.end ())
+    {
+      *j = dsts.back ();
+      dsts.pop_back ();
+    }
+  if (dsts.empty ())
+    {
+      m_nextHopIndex.erase (i);
+    }
 }
 
 bool
 RoutingTable::LookupRoute (Ipv4Address id,
                            RoutingTableEntry & rt)
 {
-  if (m_ipv4AddressEntry.empty ())
+  const RoutingTableEntry *found = FindRoute (id);
+  if (found == 0)
     {
       return false;
     }
-  std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = m_ipv4AddressEntry.find (id);
-  if (i == m_ipv4AddressEntry.end ())
-    {
-      return false;
-    }
-  rt = i->second;
+  rt = *found;
   return true;
 }
 
@@ -90,28 +304,46 @@ RoutingTable::LookupRoute (Ipv4Address id,
                            RoutingTableEntry & rt,
                            bool forRouteInput)
 {
-  if (m_ipv4AddressEntry.empty ())
+  const RoutingTableEntry *found = FindRoute (id);
+  if (found == 0)
     {
       return false;
     }
-  std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = m_ipv4AddressEntry.find (id);
-  if (i == m_ipv4AddressEntry.end ())
+  if (forRouteInput == true && id == found->GetInterface ().GetBroadcast ())
     {
       return false;
     }
-  if (forRouteInput == true && id == i->second.GetInterface ().GetBroadcast ())
+  rt = *found;
+  return true;
+}
+
+Ptr<Ipv4Route>
+RoutingTable::ResolveRoute (Ipv4Address dst) const
+{
+  const RoutingTableEntry *rt = FindRoute (dst);
+  if (rt == 0)
+    {
+      return 0;
+    }
+  if (rt->GetHop () == 1 || rt->GetNextHop () == dst)
     {
-      return false;
+      return rt->GetRoute ();
     }
-  rt = i->second;
-  return true;
+  const RoutingTableEntry *nextHop = FindRoute (rt->GetNextHop ());
+  if (nextHop == 0)
+    {
+      return 0;
+    }
+  return nextHop->GetRoute ();
 }
 
 bool
 RoutingTable::DeleteRoute (Ipv4Address dst)
 {
-  if (m_ipv4AddressEntry.erase (dst) != 0)
+  uint32_t slot = FindSlot (dst);
+  if (slot != EMPTY_SLOT && m_records[m_slots[slot]].m_hasRoute)
     {
+      RemoveRoute (slot);
       // NS_LOG_DEBUG("Route erased");
       return true;
     }
@@ -121,47 +353,153 @@ RoutingTable::DeleteRoute (Ipv4Address dst)
 uint32_t
 RoutingTable::RoutingTableSize ()
 {
-  return m_ipv4AddressEntry.size ();
+  return m_routeCount;
+}
+
+DestinationRecord &
+RoutingTable::AddRecord (Ipv4Address dst)
+{
+  uint32_t slot = HomeSlot (dst);
+  for (; m_slots[slot] != EMPTY_SLOT; slot = (slot + 1) & m_slotMask)
+    {
+      if (m_records[m_slots[slot]].m_destination == dst)
+        {
+          return m_records[m_slots[slot]];
+        }
+    }
+  uint32_t pos = m_records.size ();
+  m_slots[slot] = pos;
+  m_records.push_back (DestinationRecord (dst));
+  // Keep the load factor at or below one half
+  if (2 * m_records.size () > m_slots.size ())
+    {
+      Rehash (2 * m_slots.size ());
+    }
+  return m_records[pos];
+}
+
+void
+RoutingTable::SetRoute (DestinationRecord & record, RoutingTableEntry const & rt)
+{
+  bool expiryChanged = true;
+  if (!record.m_hasRoute)
+    {
+      LinkNextHop (rt.GetNextHop (), record.m_destination);
+      record.m_hasRoute = true;
+      record.m_nBackups = 0;
+      m_routeCount++;
+      m_generation++;
+    }
+  else
+    {
+      RoutingTableEntry & old = record.m_route;
+      if (old.GetNextHop () != rt.GetNextHop ())
+        {
+          UnlinkNextHop (old.GetNextHop (), record.m_destination);
+          LinkNextHop (rt.GetNextHop (), record.m_destination);
+          // The new next hop is no backup of itself
+          BackupNextHop *last = std::remove_if (record.m_backups, record.m_backups + record.m_nBackups,
+                                                IsBackupThrough (rt.GetNextHop ()));
+          record.m_nBackups = last - record.m_backups;
+        }
+      if (old.GetNextHop () != rt.GetNextHop () || old.GetHop () != rt.GetHop ()
+          || old.GetInterface () != rt.GetInterface () || old.GetOutputDevice () != rt.GetOutputDevice ())
+        {
+          m_generation++;
+        }
+      expiryChanged = old.GetLifeTime () != rt.GetLifeTime () || old.GetHop () != rt.GetHop ();
+    }
+  record.m_route = rt;
+  m_snapshotStale = true;
+  if (expiryChanged)
+    {
+      ScheduleExpiry (rt);
+    }
 }
 
 bool
 RoutingTable::AddRoute (RoutingTableEntry & rt)
 {
-  std::pair<std::map<Ipv4Address, RoutingTableEntry>::iterator, bool> result = m_ipv4AddressEntry.insert (std::make_pair (
-                                                                                                            rt.GetDestination (),rt));
-  return result.second;
+  DestinationRecord & record = AddRecord (rt.GetDestination ());
+  if (record.m_hasRoute)
+    {
+      return false;
+    }
+  SetRoute (record, rt);
+  return true;
 }
 
 bool
 RoutingTable::Update (RoutingTableEntry & rt)
 {
-  std::map<Ipv4Address, RoutingTableEntry>::iterator i = m_ipv4AddressEntry.find (rt.GetDestination ());
-  if (i == m_ipv4AddressEntry.end ())
+  uint32_t pos = FindEntry (rt.GetDestination ());
+  if (pos == EMPTY_SLOT || !m_records[pos].m_hasRoute)
     {
       return false;
     }
-  i->second = rt;
+  SetRoute (m_records[pos], rt);
   return true;
 }
 
 void
-RoutingTable::DeleteAllRoutesFromInterface (Ipv4InterfaceAddress iface)
+RoutingTable::SetAdvertisement (DestinationRecord & record, RoutingTableEntry const & rt)
 {
-  if (m_ipv4AddressEntry.empty ())
+  if (!record.m_hasAdvertisement)
     {
-      return;
+      m_pendingAdvertisements.insert (record.m_destination);
+      record.m_hasAdvertisement = true;
+    }
+  record.m_advertisement = rt;
+}
+
+bool
+RoutingTable::AddAdvertisement (RoutingTableEntry const & rt)
+{
+  DestinationRecord & record = AddRecord (rt.GetDestination ());
+  if (record.m_hasAdvertisement)
+    {
+      return false;
     }
-  for (std::map<Ipv4Address, RoutingTableEntry>::iterator i = m_ipv4AddressEntry.begin (); i != m_ipv4AddressEntry.end (); )
+  SetAdvertisement (record, rt);
+  return true;
+}
+
+void
+RoutingTable::DeleteAdvertisement (DestinationRecord & record)
+{
+  if (record.m_hasAdvertisement)
     {
-      if (i->second.GetInterface () == iface)
+      RemoveAdvertisement (FindSlot (record.m_destination));
+    }
+}
+
+bool
+RoutingTable::CancelSettling (DestinationRecord & record)
+{
+  bool settling = record.IsSettling ();
+  record.m_settlingDeadline = Time ();
+  return settling;
+}
+
+void
+RoutingTable::DeleteAllRoutesFromInterface (Ipv4InterfaceAddress iface)
+{
+  for (uint32_t pos = m_records.size (); pos > 0; --pos)
+    {
+      DestinationRecord & record = m_records[pos - 1];
+      bool route = record.m_hasRoute && record.m_route.GetInterface () == iface;
+      bool advertisement = record.m_hasAdvertisement && record.m_advertisement.GetInterface () == iface;
+      if ((route || !record.m_hasRoute) && (advertisement || !record.m_hasAdvertisement))
         {
-          std::map<Ipv4Address, RoutingTableEntry>::iterator tmp = i;
-          ++i;
-          m_ipv4AddressEntry.erase (tmp);
+          EraseSlot (FindSlot (record.m_destination));
         }
-      else
+      else if (route)
         {
-          ++i;
+          RemoveRoute (FindSlot (record.m_destination));
+        }
+      else if (advertisement)
+        {
+          RemoveAdvertisement (FindSlot (record.m_destination));
         }
     }
 }
@@ -169,14 +507,42 @@ RoutingTable::DeleteAllRoutesFromInterface (Ipv4InterfaceAddress iface)
 void
 RoutingTable::GetListOfAllRoutes (std::map<Ipv4Address, RoutingTableEntry> & allRoutes)
 {
-  for (std::map<Ipv4Address, RoutingTableEntry>::iterator i = m_ipv4AddressEntry.begin (); i != m_ipv4AddressEntry.end (); ++i)
+  for (std::vector<DestinationRecord>::const_iterator i = m_records.begin (); i != m_records.end (); ++i)
     {
-      if (i->second.GetDestination () != Ipv4Address ("127.0.0.1") && i->second.GetFlag () == VALID)
+      if (i->m_hasRoute && i->m_destination != Ipv4Address ("127.0.0.1") && i->m_route.GetFlag () == VALID)
         {
           allRoutes.insert (
-            std::make_pair (i->first,i->second));
+            std::make_pair (i->m_destination,i->m_route));
+        }
+    }
+}
+
+/// Orders routing table entries by destination address
+static bool
+DestinationLess (RoutingTableEntry const & a, RoutingTableEntry const & b)
+{
+  return a.GetDestination () < b.GetDestination ();
+}
+
+const std::vector<RoutingTableEntry> &
+RoutingTable::GetRouteSnapshot () const
+{
+  if (m_snapshotStale)
+    {
+      // Assigning over the former entries keeps the storage of the array
+      m_snapshot.resize (m_routeCount);
+      std::vector<RoutingTableEntry>::iterator out = m_snapshot.begin ();
+      for (std::vector<DestinationRecord>::const_iterator i = m_records.begin (); i != m_records.end (); ++i)
+        {
+          if (i->m_hasRoute)
+            {
+              *out++ = i->m_route;
+            }
         }
+      std::sort (m_snapshot.begin (), m_snapshot.end (), &DestinationLess);
+      m_snapshotStale = false;
     }
+  return m_snapshot;
 }
 
 void
@@ -184,14 +550,143 @@ RoutingTable::GetListOfDestinationWithNextHop (Ipv4Address nextHop,
                                                std::map<Ipv4Address, RoutingTableEntry> & unreachable)
 {
   unreachable.clear ();
-  for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = m_ipv4AddressEntry.begin (); i
-       != m_ipv4AddressEntry.end (); ++i)
+  std::unordered_map<Ipv4Address, std::vector<Ipv4Address>, Ipv4AddressHash>::const_iterator i =
+    m_nextHopIndex.find (nextHop);
+  if (i == m_nextHopIndex.end ())
+    {
+      return;
+    }
+  for (std::vector<Ipv4Address>::const_iterator j = i->second.begin (); j != i->second.end (); ++j)
+    {
+      unreachable.insert (std::make_pair (*j,m_records[FindEntry (*j)].m_route));
+    }
+}
+
+void
+RoutingTable::GetDestinationsWithNextHop (Ipv4Address nextHop, std::vector<Ipv4Address> & dsts) const
+{
+  std::unordered_map<Ipv4Address, std::vector<Ipv4Address>, Ipv4AddressHash>::const_iterator i =
+    m_nextHopIndex.find (nextHop);
+  if (i != m_nextHopIndex.end ())
+    {
+      dsts.insert (dsts.end (), i->second.begin (), i->second.end ());
+    }
+}
+
+void
+RoutingTable::DeleteRoutesWithNextHop (Ipv4Address nextHop,
+                                       std::vector<RoutingTableEntry> & removed)
+{
+  std::unordered_map<Ipv4Address, std::vector<Ipv4Address>, Ipv4AddressHash>::iterator i =
+    m_nextHopIndex.find (nextHop);
+  if (i == m_nextHopIndex.end ())
+    {
+      return;
+    }
+  std::vector<Ipv4Address> dsts;
+  dsts.swap (i->second);
+  m_nextHopIndex.erase (i);
+  removed.reserve (removed.size () + dsts.size ());
+  for (std::vector<Ipv4Address>::const_iterator j = dsts.begin (); j != dsts.end (); ++j)
+    {
+      uint32_t slot = FindSlot (*j);
+      removed.push_back (m_records[m_slots[slot]].m_route);
+      RemoveRoute (slot);
+    }
+}
+
+uint32_t
+RoutingTable::FailOverRoutesWithNextHop (Ipv4Address nextHop,
+                                         std::vector<RoutingTableEntry> & removed)
+{
+  std::unordered_map<Ipv4Address, std::vector<Ipv4Address>, Ipv4AddressHash>::iterator i =
+    m_nextHopIndex.find (nextHop);
+  if (i == m_nextHopIndex.end ())
+    {
+      return 0;
+    }
+  // copy, as moving the routes edits the index
+  std::vector<Ipv4Address> dsts = i->second;
+  uint32_t moved = 0;
+  for (std::vector<Ipv4Address>::const_iterator j = dsts.begin (); j != dsts.end (); ++j)
+    {
+      uint32_t slot = FindSlot (*j);
+      DestinationRecord & record = m_records[m_slots[slot]];
+      if (FailOver (record, nextHop))
+        {
+          moved++;
+          continue;
+        }
+      removed.push_back (record.m_route);
+      RemoveRoute (slot);
+    }
+  return moved;
+}
+
+void
+RoutingTable::AddBackup (DestinationRecord & record, Ipv4Address nextHop, uint32_t hops)
+{
+  if (nextHop == record.m_route.GetNextHop ())
+    {
+      return;
+    }
+  BackupNextHop *end = std::remove_if (record.m_backups, record.m_backups + record.m_nBackups,
+                                       IsBackupThrough (nextHop));
+  // Ahead of the backups with as many hops, as it is the most recent
+  BackupNextHop *pos = record.m_backups;
+  while (pos != end && pos->hops < hops)
+    {
+      ++pos;
+    }
+  if (pos == record.m_backups + DestinationRecord::MAX_BACKUPS)
+    {
+      record.m_nBackups = end - record.m_backups;
+      return;
+    }
+  if (end == record.m_backups + DestinationRecord::MAX_BACKUPS)
+    {
+      // Drop the worst one
+      --end;
+    }
+  std::copy_backward (pos, end, end + 1);
+  pos->nextHop = nextHop;
+  pos->hops = hops;
+  pos->learned = Simulator::Now ();
+  record.m_nBackups = end + 1 - record.m_backups;
+}
+
+bool
+RoutingTable::FailOver (DestinationRecord & record, Ipv4Address nextHop)
+{
+  for (uint32_t i = 0; i < record.m_nBackups; i++)
     {
-      if (i->second.GetNextHop () == nextHop)
+      BackupNextHop backup = record.m_backups[i];
+      const RoutingTableEntry *neighbor = FindRoute (backup.nextHop);
+      if (backup.nextHop == nextHop || neighbor == 0 || neighbor->GetHop () != 1
+          || neighbor->GetNextHop () != backup.nextHop || Simulator::Now () - backup.learned > m_holddownTime)
         {
-          unreachable.insert (std::make_pair (i->first,i->second));
+          continue;
         }
+      RoutingTableEntry const & old = record.m_route;
+      RoutingTableEntry rt (neighbor->GetOutputDevice (), record.m_destination, old.GetSeqNo (),
+                            neighbor->GetInterface (), backup.hops, backup.nextHop, backup.learned,
+                            old.GetSettlingTime (), old.GetEntriesChanged ());
+      rt.SetFlag (old.GetFlag ());
+      // The backups ranked above this one are of no use any more
+      std::copy (record.m_backups + i + 1, record.m_backups + record.m_nBackups, record.m_backups);
+      record.m_nBackups -= i + 1;
+      SetRoute (record, rt);
+      m_failedOver.push_back (record.m_destination);
+      return true;
     }
+  return false;
+}
+
+void
+RoutingTable::TakeFailedOver (std::vector<Ipv4Address> & dsts)
+{
+  dsts.insert (dsts.end (), m_failedOver.begin (), m_failedOver.end ());
+  m_failedOver.clear ();
 }
 
 void
@@ -205,8 +700,8 @@ RoutingTableEntry::Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit /*= T
   *os << std::resetiosflags (std::ios::adjustfield) << std::setiosflags (std::ios::left);
 
   std::ostringstream dest, gw, iface, ltime, stime;
-  dest << m_ipv4Route->GetDestination ();
-  gw << m_ipv4Route->GetGateway ();
+  dest << GetDestination ();
+  gw << GetNextHop ();
   iface << m_iface.GetLocal ();
   ltime << std::setprecision (3) << (Simulator::Now () - m_lifeTime).As (unit);
   stime << m_settlingTime.As (unit);
@@ -222,48 +717,60 @@ RoutingTableEntry::Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit /*= T
   (*os).copyfmt (oldState);
 }
 
-void
+uint32_t
 RoutingTable::Purge (std::map<Ipv4Address, RoutingTableEntry> & removedAddresses)
 {
-  if (m_ipv4AddressEntry.empty ())
-    {
-      return;
-    }
-  for (std::map<Ipv4Address, RoutingTableEntry>::iterator i = m_ipv4AddressEntry.begin (); i != m_ipv4AddressEntry.end (); )
+  uint32_t moved = 0;
+  Time now = Simulator::Now ();
+  while (!m_expiryQueue.empty () && m_expiryQueue.front ().first < now)
     {
-      std::map<Ipv4Address, RoutingTableEntry>::iterator itmp = i;
-      if (i->second.GetLifeTime () > m_holddownTime && (i->second.GetHop () > 0))
+      Ipv4Address dst = m_expiryQueue.front ().second;
+      std::pop_heap (m_expiryQueue.begin (), m_expiryQueue.end (), std::greater<std::pair<Time, Ipv4Address> > ());
+      m_expiryQueue.pop_back ();
+      const RoutingTableEntry *expired = FindRoute (dst);
+      if (expired == 0 || !(expired->GetLifeTime () > m_holddownTime && (expired->GetHop () > 0)))
+        {
+          // deleted or refreshed since this deadline was queued
+          continue;
+        }
+      RoutingTableEntry rt = *expired;
+      std::unordered_map<Ipv4Address, std::vector<Ipv4Address>, Ipv4AddressHash>::const_iterator deps =
+        m_nextHopIndex.find (dst);
+      if (deps != m_nextHopIndex.end ())
         {
-          for (std::map<Ipv4Address, RoutingTableEntry>::iterator j = m_ipv4AddressEntry.begin (); j != m_ipv4AddressEntry.end (); )
+          // copy, as erasing the dependents edits the index
+          std::vector<Ipv4Address> dependents = deps->second;
+          for (std::vector<Ipv4Address>::const_iterator j = dependents.begin (); j != dependents.end (); ++j)
             {
-              if ((j->second.GetNextHop () == i->second.GetDestination ()) && (i->second.GetHop () != j->second.GetHop ()))
-                {
-                  std::map<Ipv4Address, RoutingTableEntry>::iterator jtmp = j;
-                  removedAddresses.insert (std::make_pair (j->first,j->second));
-                  ++j;
-                  m_ipv4AddressEntry.erase (jtmp);
-                }
-              else
+              const RoutingTableEntry *dependent = FindRoute (*j);
+              if (dependent != 0 && dependent->GetHop () != rt.GetHop ())
                 {
-                  ++j;
+                  uint32_t slot = FindSlot (*j);
+                  if (FailOver (m_records[m_slots[slot]], dst))
+                    {
+                      moved++;
+                      continue;
+                    }
+                  removedAddresses.insert (std::make_pair (*j,*dependent));
+                  RemoveRoute (slot);
                 }
             }
-          removedAddresses.insert (std::make_pair (i->first,i->second));
-          ++i;
-          m_ipv4AddressEntry.erase (itmp);
-        }
-      /** \todo Need to decide when to invalidate a route */
-      /*          else if (i->second.GetLifeTime() > m_holddownTime)
-       {
-       ++i;
-       itmp->second.SetFlag(INVALID);
-       }*/
-      else
-        {
-          ++i;
         }
+      removedAddresses.insert (std::make_pair (dst,rt));
+      RemoveRoute (FindSlot (dst));
+    }
+  return moved;
+}
+
+bool
+RoutingTable::GetNextExpiry (Time & next) const
+{
+  if (m_expiryQueue.empty ())
+    {
+      return false;
     }
-  return;
+  next = m_expiryQueue.front ().first;
+  return true;
 }
 
 void
@@ -284,10 +791,10 @@ RoutingTable::Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit /*= Time::
   *os << std::setw (16) << "SeqNum";
   *os << std::setw (16) << "LifeTime";
   *os << "SettlingTime" << std::endl;
-  for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = m_ipv4AddressEntry.begin (); i
-       != m_ipv4AddressEntry.end (); ++i)
+  const std::vector<RoutingTableEntry> & routes = GetRouteSnapshot ();
+  for (std::vector<RoutingTableEntry>::const_iterator i = routes.begin (); i != routes.end (); ++i)
     {
-      i->second.Print (stream, unit);
+      i->Print (stream, unit);
     }
   *os << std::endl;
   // Restore the previous ostream state
@@ -295,146 +802,101 @@ RoutingTable::Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit /*= Time::
 }
 
 bool
-RoutingTable::AddIpv4Event (Ipv4Address address,
-                            EventId id)
+RoutingTable::GetNextSettlingDeadline (Time & next) const
 {
-  std::pair<std::map<Ipv4Address, EventId>::iterator, bool> result = m_ipv4Events.insert (std::make_pair (address,id));
-  return result.second;
+  bool found = false;
+  for (std::unordered_set<Ipv4Address, Ipv4AddressHash>::const_iterator i = m_pendingAdvertisements.begin ();
+       i != m_pendingAdvertisements.end (); ++i)
+    {
+      const DestinationRecord & record = m_records[FindEntry (*i)];
+      if (record.IsSettling () && (!found || record.m_settlingDeadline < next))
+        {
+          next = record.m_settlingDeadline;
+          found = true;
+        }
+    }
+  return found;
 }
 
-bool
-RoutingTable::AnyRunningEvent (Ipv4Address address)
+void
+RoutingTable::TakeChangedRoutes (std::vector<RoutingTableEntry> & ready)
 {
-  EventId event;
-  std::map<Ipv4Address, EventId>::const_iterator i = m_ipv4Events.find (address);
-  if (m_ipv4Events.empty ())
-    {
-      return false;
-    }
-  if (i == m_ipv4Events.end ())
-    {
-      return false;
-    }
-  event = i->second;
-  if (event.IsRunning ())
-    {
-      return true;
-    }
-  else
+  for (std::unordered_set<Ipv4Address, Ipv4AddressHash>::iterator i = m_pendingAdvertisements.begin ();
+       i != m_pendingAdvertisements.end (); )
     {
-      return false;
+      uint32_t slot = FindSlot (*i);
+      const DestinationRecord & record = m_records[m_slots[slot]];
+      const RoutingTableEntry & rt = record.m_advertisement;
+      if (!rt.GetEntriesChanged () || rt.GetFlag () != VALID || rt.GetDestination () == Ipv4Address ("127.0.0.1")
+          || record.IsSettling ())
+        {
+          ++i;
+          continue;
+        }
+      ready.push_back (rt);
+      // Erase through the iterator first, RemoveAdvertisement then finds nothing left to erase
+      i = m_pendingAdvertisements.erase (i);
+      RemoveAdvertisement (slot);
     }
 }
+///////Maisha///////
+void 
+RoutingTable::AddMobilityData(Ipv4Address src, uint32_t x, uint32_t y, float v)
+{
+  m_locationTable.Update (src, x, y, v);
+}
 
-bool
-RoutingTable::ForceDeleteIpv4Event (Ipv4Address address)
+uint32_t
+RoutingTable::PurgeLocations ()
 {
-  EventId event;
-  std::map<Ipv4Address, EventId>::const_iterator i = m_ipv4Events.find (address);
-  if (m_ipv4Events.empty () || i == m_ipv4Events.end ())
-    {
-      return false;
-    }
-  event = i->second;
-  Simulator::Cancel (event);
-  m_ipv4Events.erase (address);
-  return true;
+  return m_locationTable.Purge (Simulator::Now () - m_holddownTime);
 }
 
 bool
-RoutingTable::DeleteIpv4Event (Ipv4Address address)
+RoutingTable::IsCloserTo (Ipv4Address dst, Ipv4Address candidate, Ipv4Address current) const
 {
-  EventId event;
-  std::map<Ipv4Address, EventId>::const_iterator i = m_ipv4Events.find (address);
-  if (m_ipv4Events.empty () || i == m_ipv4Events.end ())
-    {
-      return false;
-    }
-  event = i->second;
-  if (event.IsRunning ())
+  double dx, dy, cx, cy, x, y;
+  float v;
+  if (!m_locationTable.Lookup (dst, dx, dy, v) || !m_locationTable.Lookup (candidate, x, y, v)
+      || !m_locationTable.Lookup (current, cx, cy, v))
     {
       return false;
     }
-  if (event.IsExpired ())
-    {
-      event.Cancel ();
-      m_ipv4Events.erase (address);
-      return true;
-    }
-  else
-    {
-      m_ipv4Events.erase (address);
-      return true;
-    }
+  return (x - dx) * (x - dx) + (y - dy) * (y - dy) < (cx - dx) * (cx - dx) + (cy - dy) * (cy - dy);
 }
 
-EventId
-RoutingTable::GetEventId (Ipv4Address address)
-{
-  std::map <Ipv4Address, EventId>::const_iterator i = m_ipv4Events.find (address);
-  if (m_ipv4Events.empty () || i == m_ipv4Events.end ())
-    {
-      return EventId ();
-    }
-  else
-    {
-      return i->second;
-    }
-}
-///////Maisha///////
-void 
-RoutingTable::AddMobilityData(Ipv4Address src, uint32_t x, uint32_t y, float v)
+void
+RoutingTable::GetNeighboursInCone (Ipv4Address dst, Ipv4Address self, std::vector<Ipv4Address> & neighbours) const
 {
-  for(std::map <Ipv4Address,std::tuple<uint32_t,uint32_t,float>>::const_iterator i=m_locationEntry.begin();i!=m_locationEntry.end();++i)
-  {
-    if(i->first==src)
+  std::vector<Ipv4Address>::size_type first = neighbours.size ();
+  m_locationTable.GetNodesInCone (self, dst, neighbours);
+  std::vector<Ipv4Address>::iterator last = neighbours.begin () + first;
+  for (std::vector<Ipv4Address>::iterator i = last; i != neighbours.end (); ++i)
     {
-      m_locationEntry.erase(i);
+      const RoutingTableEntry *rt = FindRoute (*i);
+      if (rt != 0 && rt->GetHop () == 1)
+        {
+          *last++ = *i;
+        }
     }
-  }
-  m_locationEntry.insert({src, std::make_tuple(x,y,v)});
+  neighbours.erase (last, neighbours.end ());
 }
 
-
-
-Ipv4Address 
-RoutingTable::getClosestAddress(Ipv4Address src)
+bool
+RoutingTable::IsBetterGeographicNextHop (Ipv4Address dst, Ipv4Address self, Ipv4Address candidate,
+                                         Ipv4Address current) const
 {
-  uint32_t x=0,y=0;
-  Ipv4Address address=Ipv4Address();
-  
-  float v=0.0;
-  for(std::map <Ipv4Address,std::tuple<uint32_t,uint32_t,float>>::const_iterator i=m_locationEntry.begin();i!=m_locationEntry.end();++i)
-  {
-    if(i->first==src)
+  m_coneNeighbours.clear ();
+  GetNeighboursInCone (dst, self, m_coneNeighbours);
+  if (std::find (m_coneNeighbours.begin (), m_coneNeighbours.end (), candidate) == m_coneNeighbours.end ())
     {
-      x=std::get<0>(i->second);
-      y=std::get<1>(i->second);
-      v=std::get<2>(i->second);
+      return false;
     }
-  }
-  if(x==0&&y==0&&v==0.0)
-  return Ipv4Address();
-  float theta = std::atan(y/x);
-  float  min=-999999999.99;
-  for(std::map <Ipv4Address,std::tuple<uint32_t,uint32_t,float>>::const_iterator i=m_locationEntry.begin();i!=m_locationEntry.end();++i)
-  {
-    if(i->first!=src)
-    {
-      x=std::get<0>(i->second);
-      y=std::get<1>(i->second);
-      v=std::get<2>(i->second);
-      float alpha=std::asin(v*0.000000015/sqrt(x*x+y*y));
-      if(std::abs(alpha-theta)<min)
-      {
-        min=alpha;
-        address=i->first;
-      }
+  if (std::find (m_coneNeighbours.begin (), m_coneNeighbours.end (), current) == m_coneNeighbours.end ())
+    {
+      return true;
     }
-  }
-
-return address;
-  
+  return IsCloserTo (dst, candidate, current);
 }
   ////////////////////
 }
@@ -35,11 +35,14 @@
 #include <cassert>
 #include <bits/stdc++.h>
 #include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-route.h"
 #include "ns3/timer.h"
 #include "ns3/net-device.h"
 #include "ns3/output-stream-wrapper.h"
+#include "dream-location-table.h"
 
 namespace ns3 {
 namespace dream {
@@ -56,6 +59,12 @@ enum RouteFlags
 class RoutingTableEntry
 {
 public:
+  /**
+   * Default c-tor. The entry gets its IPv4 route only once one of the route
+   * fields is set or another entry is assigned to it, so that the entries
+   * used as the target of a lookup do not allocate.
+   */
+  RoutingTableEntry ();
   /**
    * c-tor
    *
@@ -69,7 +78,7 @@ public:
    * \param SettlingTime the settling time
    * \param changedEntries flag for changed entries
    */
-  RoutingTableEntry (Ptr<NetDevice> dev = 0, Ipv4Address dst = Ipv4Address (), uint32_t seqNo = 0,
+  RoutingTableEntry (Ptr<NetDevice> dev, Ipv4Address dst = Ipv4Address (), uint32_t seqNo = 0,
                      Ipv4InterfaceAddress iface = Ipv4InterfaceAddress (), uint32_t hops = 0, Ipv4Address nextHop = Ipv4Address (),
                      Time lifetime = Simulator::Now (), Time SettlingTime = Simulator::Now (), bool changedEntries = false);
 
@@ -81,7 +90,7 @@ public:
   Ipv4Address
   GetDestination () const
   {
-    return m_ipv4Route->GetDestination ();
+    return m_ipv4Route == 0 ? Ipv4Address () : m_ipv4Route->GetDestination ();
   }
   /**
    * Get route
@@ -108,6 +117,7 @@ public:
   void
   SetNextHop (Ipv4Address nextHop)
   {
+    UnshareRoute ();
     m_ipv4Route->SetGateway (nextHop);
   }
   /**
@@ -117,7 +127,7 @@ public:
   Ipv4Address
   GetNextHop () const
   {
-    return m_ipv4Route->GetGateway ();
+    return m_ipv4Route == 0 ? Ipv4Address () : m_ipv4Route->GetGateway ();
   }
   /**
    * Set output device
@@ -126,6 +136,7 @@ public:
   void
   SetOutputDevice (Ptr<NetDevice> device)
   {
+    UnshareRoute ();
     m_ipv4Route->SetOutputDevice (device);
   }
   /**
@@ -135,7 +146,7 @@ public:
   Ptr<NetDevice>
   GetOutputDevice () const
   {
-    return m_ipv4Route->GetOutputDevice ();
+    return m_ipv4Route == 0 ? Ptr<NetDevice> () : m_ipv4Route->GetOutputDevice ();
   }
   /**
    * Get interface address
@@ -246,7 +257,9 @@ public:
     return m_flag;
   }
   /**
-   * Set entries changed indicator
+   * Set entries changed indicator. In the advertised table it marks a route
+   * waiting to be advertised, in the main table a route changed since the
+   * last periodic update.
    * \param entriesChanged
    */
   void
@@ -271,7 +284,7 @@ public:
   bool
   operator== (Ipv4Address const destination) const
   {
-    return (m_ipv4Route->GetDestination () == destination);
+    return (GetDestination () == destination);
   }
   /**
    * Print routing table entry
@@ -281,6 +294,24 @@ public:
   Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const;
 
 private:
+  /**
+   * Give this entry its own copy of the IPv4 route before modifying it.
+   * Copies of an entry share the route, and without this a next hop set on
+   * a copy would silently change the entry stored in the routing table.
+   */
+  void
+  UnshareRoute ()
+  {
+    if (m_ipv4Route == 0)
+      {
+        m_ipv4Route = Create<Ipv4Route> ();
+      }
+    else if (m_ipv4Route->GetReferenceCount () > 1)
+      {
+        m_ipv4Route = Create<Ipv4Route> (*m_ipv4Route);
+      }
+  }
+
   // Fields
   /// Destination Sequence Number
   uint32_t m_seqNo;
@@ -312,9 +343,167 @@ private:
 
 };
 
+/**
+ * \ingroup dream
+ * \brief A neighbour, other than the next hop in use, through which a
+ * destination is also reachable
+ */
+struct BackupNextHop
+{
+  Ipv4Address nextHop; ///< the neighbour
+  uint32_t hops; ///< hop count to the destination through the neighbour
+  Time learned; ///< time the neighbour was last seen to lead to the destination
+};
+
+/**
+ * \ingroup dream
+ * \brief Everything the routing table keeps about one destination: the route
+ * used to forward packets to it, the advertisement of the destination waiting
+ * to be sent in a triggered update, and the time until which a changed metric
+ * is held back before it is advertised (the weighted settling time).
+ * Either of the route and the advertisement may be missing; for a route
+ * withdrawn with an infinite metric only the advertisement is left.
+ * Along with the route, a few ranked backup next hops are kept, which the
+ * route falls over to when its next hop goes away.
+ */
+class DestinationRecord
+{
+public:
+  /**
+   * c-tor
+   * \param dst the destination IP address
+   */
+  DestinationRecord (Ipv4Address dst = Ipv4Address ())
+    : m_destination (dst),
+      m_hasRoute (false),
+      m_hasAdvertisement (false),
+      m_nBackups (0)
+  {
+  }
+  /// Largest number of backup next hops kept per destination
+  static const uint32_t MAX_BACKUPS = 3;
+  /**
+   * Get destination IP address
+   * \returns the destination IPv4 address
+   */
+  Ipv4Address
+  GetDestination () const
+  {
+    return m_destination;
+  }
+  /**
+   * Whether packets can be forwarded to the destination
+   * \returns true if the record holds a route
+   */
+  bool
+  HasRoute () const
+  {
+    return m_hasRoute;
+  }
+  /**
+   * Get the route used to forward packets. Only meaningful if HasRoute ().
+   * \returns the routing table entry
+   */
+  RoutingTableEntry const &
+  GetRouteEntry () const
+  {
+    return m_route;
+  }
+  /**
+   * Whether an advertisement of the destination is waiting to be sent
+   * \returns true if the record holds an advertisement
+   */
+  bool
+  HasAdvertisement () const
+  {
+    return m_hasAdvertisement;
+  }
+  /**
+   * Get the advertisement waiting to be sent. Only meaningful if HasAdvertisement ().
+   * \returns the advertised routing table entry
+   */
+  RoutingTableEntry const &
+  GetAdvertisement () const
+  {
+    return m_advertisement;
+  }
+  /**
+   * Whether the advertisement is held back until its settling time is over
+   * \returns true if the settling time is not over
+   */
+  bool
+  IsSettling () const
+  {
+    return m_hasAdvertisement && m_settlingDeadline > Simulator::Now ();
+  }
+  /**
+   * Get the time at which the settling time is over
+   * \returns the settling deadline
+   */
+  Time
+  GetSettlingDeadline () const
+  {
+    return m_settlingDeadline;
+  }
+  /**
+   * Get the number of backup next hops of the route
+   * \returns the number of backups
+   */
+  uint32_t
+  GetNBackups () const
+  {
+    return m_nBackups;
+  }
+  /**
+   * Get a backup next hop of the route
+   * \param i the rank of the backup, 0 for the best one
+   * \returns the backup
+   */
+  BackupNextHop const &
+  GetBackup (uint32_t i) const
+  {
+    return m_backups[i];
+  }
+
+private:
+  friend class RoutingTable;
+  /// Destination address
+  Ipv4Address m_destination;
+  /// Route used to forward packets
+  RoutingTableEntry m_route;
+  /// Advertisement waiting to be sent
+  RoutingTableEntry m_advertisement;
+  /// Time at which the advertisement may be sent
+  Time m_settlingDeadline;
+  /// Whether m_route is in use
+  bool m_hasRoute;
+  /// Whether m_advertisement is in use
+  bool m_hasAdvertisement;
+  /// Backup next hops of the route, best first: fewest hops, then most recently learned
+  BackupNextHop m_backups[MAX_BACKUPS];
+  /// Number of backups in use
+  uint32_t m_nBackups;
+};
+
 /**
  * \ingroup dream
  * \brief The Routing table used by dream protocol
+ *
+ * One DestinationRecord per destination holds both its route and its pending
+ * advertisement.  Records are kept in a contiguous array and indexed by an
+ * open-addressing hash table keyed by the 32-bit destination address, so
+ * that the lookups done for every forwarded packet and every received update
+ * record cost a single probe in the common case.
+ * Purge pops expired routes off a min-heap ordered by expiry time and finds
+ * their dependents through a next hop to destinations index, so it only
+ * touches the routes it removes.  The destinations with a pending
+ * advertisement are kept in a separate set, so that triggered updates are
+ * built in time proportional to the number of changed routes.
+ *
+ * The route oriented methods (AddRoute, LookupRoute, Update, DeleteRoute...)
+ * only see the routes; the advertisements are reached through the records.
+ * Periodic dumps and Print walk a sorted snapshot of the routes instead of
+ * copying them into a map.
  */
 class RoutingTable
 {
@@ -352,6 +541,39 @@ public:
    */
   bool
   LookupRoute (Ipv4Address id, RoutingTableEntry & rt, bool forRouteInput);
+  /**
+   * Lookup routing table entry with destination address dst without copying it
+   * \param dst destination address
+   * \return the entry, or 0 if there is none. The pointer is only valid until
+   * the table is next modified.
+   */
+  const RoutingTableEntry *
+  FindRoute (Ipv4Address dst) const
+  {
+    uint32_t pos = FindEntry (dst);
+    return pos == EMPTY_SLOT || !m_records[pos].m_hasRoute ? 0 : &m_records[pos].m_route;
+  }
+  /**
+   * Resolve the route used to forward a packet to dst: the route of the
+   * destination itself when it is its own next hop or a neighbour, and the
+   * route of its next hop otherwise.
+   * \param dst destination address
+   * \return the route, or 0 if dst or its next hop is not in the table
+   */
+  Ptr<Ipv4Route>
+  ResolveRoute (Ipv4Address dst) const;
+  /**
+   * Get the generation of the routes. It changes whenever a route is added or
+   * removed, or changes its next hop, hop count, interface or device, that is
+   * whenever ResolveRoute may give another answer. Refreshing the lifetime or
+   * the sequence number of a route leaves it unchanged.
+   * \return the generation
+   */
+  uint64_t
+  GetGeneration () const
+  {
+    return m_generation;
+  }
   /**
    * Updating the routing Table with routing table entry rt
    * \param rt routing table entry
@@ -366,12 +588,46 @@ public:
    */
   void
   GetListOfDestinationWithNextHop (Ipv4Address nxtHp, std::map<Ipv4Address, RoutingTableEntry> & dstList);
+  /**
+   * Append the destinations for which nextHop is the next hop to dsts, from the next hop index
+   * \param nextHop next hop address
+   * \param dsts the destinations
+   */
+  void
+  GetDestinationsWithNextHop (Ipv4Address nextHop, std::vector<Ipv4Address> & dsts) const;
+  /**
+   * Delete all routes for which nextHop is the next hop address, in time
+   * proportional to the number of such routes
+   * \param nextHop next hop address
+   * \param removed the deleted entries are appended to this list
+   */
+  void
+  DeleteRoutesWithNextHop (Ipv4Address nextHop, std::vector<RoutingTableEntry> & removed);
+  /**
+   * Move the routes for which nextHop is the next hop to their best usable
+   * backup, and delete the routes that have none. A backup is usable if it is
+   * still a 1-hop neighbour and led to the destination within the hold down time.
+   * \param nextHop next hop address that went away
+   * \param removed the deleted entries are appended to this list
+   * \return the number of routes moved to a backup
+   */
+  uint32_t
+  FailOverRoutesWithNextHop (Ipv4Address nextHop, std::vector<RoutingTableEntry> & removed);
   /**
    * Lookup list of all addresses in the routing table
    * \param allRoutes is the list that will hold all these addresses present in the nodes routing table
    */
   void
   GetListOfAllRoutes (std::map<Ipv4Address, RoutingTableEntry> & allRoutes);
+  /**
+   * Get all the routes of the table, sorted by destination address, in a
+   * contiguous array. The snapshot is only rebuilt, in place, when the routes
+   * changed since it was last taken, so walking it allocates nothing.
+   * \return the routes. The snapshot is left untouched by changes to the table
+   * and stays valid until the next call.
+   */
+  const std::vector<RoutingTableEntry> &
+  GetRouteSnapshot () const;
   /**
    * Delete all route from interface with address iface
    * \param iface the interface
@@ -380,16 +636,23 @@ public:
   DeleteAllRoutesFromInterface (Ipv4InterfaceAddress iface);
   /// Delete all entries from routing table
   void
-  Clear ()
-  {
-    m_ipv4AddressEntry.clear ();
-  }
+  Clear ();
   /**
-   * Delete all outdated entries if Lifetime is expired
+   * Delete all outdated entries if Lifetime is expired. The routes that
+   * depend on an expired next hop fall over to a backup if they have one.
    * \param removedAddresses is the list of addresses to purge
+   * \return the number of routes that fell over to a backup
    */
-  void
+  uint32_t
   Purge (std::map<Ipv4Address, RoutingTableEntry> & removedAddresses);
+  /**
+   * Get the earliest expiry time queued. Purge removes the route once this time
+   * has passed, unless the route was refreshed or deleted in the meantime.
+   * \param next the earliest expiry time
+   * \return false if no route is due to expire
+   */
+  bool
+  GetNextExpiry (Time & next) const;
   /**
    * Print routing table
    * \param stream the output stream
@@ -403,47 +666,170 @@ public:
   uint32_t
   RoutingTableSize ();
   /**
-  * Add an event for a destination address so that the update to for that destination is sent
-  * after the event is completed.
-  * \param address destination address for which this event is running.
-  * \param id unique eventid that was generated.
-  * \return true on success
-  */
+   * Find the record of a destination
+   * \param dst destination address
+   * \return the record, or 0 if the table knows nothing about dst. The pointer
+   * is only valid until a record is next added or removed.
+   */
+  DestinationRecord *
+  FindRecord (Ipv4Address dst)
+  {
+    uint32_t pos = FindEntry (dst);
+    return pos == EMPTY_SLOT ? 0 : &m_records[pos];
+  }
+  /**
+   * Find the record of a destination, adding an empty one if there is none.
+   * Empty records are removed again once they get and lose a route or an advertisement.
+   * \param dst destination address
+   * \return the record, valid until a record is next added or removed
+   */
+  DestinationRecord &
+  AddRecord (Ipv4Address dst);
+  /**
+   * Install or replace the route of a destination
+   * \param record the record of the destination
+   * \param rt the route
+   */
+  void
+  SetRoute (DestinationRecord & record, RoutingTableEntry const & rt);
+  /**
+   * Install or replace the advertisement of a destination
+   * \param record the record of the destination
+   * \param rt the routing table entry to advertise
+   */
+  void
+  SetAdvertisement (DestinationRecord & record, RoutingTableEntry const & rt);
+  /**
+   * Add an advertisement for the destination of rt, if it has none yet
+   * \param rt the routing table entry to advertise
+   * \return true if the advertisement was added
+   */
   bool
-  AddIpv4Event (Ipv4Address address, EventId id);
+  AddAdvertisement (RoutingTableEntry const & rt);
   /**
-  * Clear up the entry from the map after the event is completed
-  * \param address destination address for which this event is running.
-  * \return true on success
-  */
+   * Forget the advertisement of a destination along with its settling time.
+   * The record is removed, and the reference becomes invalid, if it holds no route.
+   * \param record the record of the destination
+   */
+  void
+  DeleteAdvertisement (DestinationRecord & record);
+  /**
+   * Remember a neighbour, other than the next hop of the route, through which
+   * a destination is also reachable. Backups are ranked by hop count, then by
+   * the time they were learned; only the best DestinationRecord::MAX_BACKUPS
+   * are kept.
+   * \param record the record of the destination, which holds a route
+   * \param nextHop the neighbour
+   * \param hops hop count to the destination through the neighbour
+   */
+  void
+  AddBackup (DestinationRecord & record, Ipv4Address nextHop, uint32_t hops);
+  /**
+   * Move the route of a record to its best usable backup next hop, see
+   * FailOverRoutesWithNextHop
+   * \param record the record of the destination, which holds a route
+   * \param nextHop the next hop that went away
+   * \return false if the route has no usable backup
+   */
   bool
-  DeleteIpv4Event (Ipv4Address address);
+  FailOver (DestinationRecord & record, Ipv4Address nextHop);
+  /**
+   * Append the destinations whose route moved to a backup next hop since the
+   * last call to dsts, and forget them
+   * \param dsts the destinations
+   */
+  void
+  TakeFailedOver (std::vector<Ipv4Address> & dsts);
   /**
-  * Force delete an update waiting for settling time to complete as a better update to
-  * same destination was received.
-  * \param address destination address for which this event is running.
-  * \return true on success
-  */
+   * Hold back the advertisement of a destination until its settling time is over
+   * \param record the record of the destination, which holds an advertisement
+   * \param deadline time at which the advertisement may be sent
+   */
+  void
+  SetSettlingDeadline (DestinationRecord & record, Time deadline)
+  {
+    record.m_settlingDeadline = deadline;
+  }
+  /**
+   * Release the advertisement of a destination before its settling time is over,
+   * as a better update to the same destination was received.
+   * \param record the record of the destination
+   * \return true if the advertisement was settling
+   */
   bool
-  AnyRunningEvent (Ipv4Address address);
+  CancelSettling (DestinationRecord & record);
   /**
-  * Force delete an update waiting for settling time to complete as a better update to
-  * same destination was received.
-  * \param address destination address for which this event is running.
-  * \return true on finding out that an event is already running for that destination address.
-  */
+   * Get the earliest settling time of the pending advertisements that is not over yet
+   * \param next the earliest deadline
+   * \return false if no advertisement is waiting for its settling time
+   */
   bool
-  ForceDeleteIpv4Event (Ipv4Address address);
-  /**
-    * Get the EcentId associated with that address.
-    * \param address destination address for which this event is running.
-    * \return EventId on finding out an event is associated else return NULL.
-    */
-  EventId
-  GetEventId (Ipv4Address address);
+  GetNextSettlingDeadline (Time & next) const;
+  /**
+   * Remove the valid changed advertisements whose settling time is over and
+   * append them to ready. Only the pending advertisements are visited.
+   * \param ready the removed advertisements
+   */
+  void
+  TakeChangedRoutes (std::vector<RoutingTableEntry> & ready);
+  /**
+   * Provides the number of advertisements waiting to be sent
+   * \returns the number of pending advertisements
+   */
+  uint32_t
+  PendingAdvertisementsSize () const
+  {
+    return m_pendingAdvertisements.size ();
+  }
   ///////Maisha///////
   void AddMobilityData(Ipv4Address src, uint32_t x, uint32_t y, float v);
-  Ipv4Address getClosestAddress(Ipv4Address src);
+  /**
+   * Delete the locations of the nodes not heard from for the hold down time
+   * \return the number of locations deleted
+   */
+  uint32_t
+  PurgeLocations ();
+  /**
+   * Compare the distances of two nodes to the last known location of dst
+   * \param dst the destination
+   * \param candidate the node that may replace current
+   * \param current the node currently used
+   * \return true if the locations of all three are known and candidate is strictly closer to dst than current
+   */
+  bool
+  IsCloserTo (Ipv4Address dst, Ipv4Address candidate, Ipv4Address current) const;
+  /**
+   * Get the 1-hop neighbours of self that are in the DREAM expected-zone
+   * cone toward dst (see LocationTable::GetNodesInCone)
+   * \param dst the destination
+   * \param self the address of this node
+   * \param neighbours the neighbours in the cone are appended to this list
+   */
+  void
+  GetNeighboursInCone (Ipv4Address dst, Ipv4Address self, std::vector<Ipv4Address> & neighbours) const;
+  /**
+   * Whether a neighbour that advertises the same metric as the current next
+   * hop of dst is the better one to forward to. DREAM forwards toward the
+   * expected zone of dst, so candidate has to be in the cone of self toward
+   * dst (see GetNeighboursInCone); it is better if current is not, or if it
+   * is also closer to the last known location of dst than current.
+   * \param dst the destination
+   * \param self the address of this node
+   * \param candidate the neighbour that may replace current
+   * \param current the next hop currently used
+   * \return true if candidate is to replace current
+   */
+  bool
+  IsBetterGeographicNextHop (Ipv4Address dst, Ipv4Address self, Ipv4Address candidate, Ipv4Address current) const;
+  /**
+   * Get the location table
+   * \return the location table
+   */
+  LocationTable &
+  GetLocationTable ()
+  {
+    return m_locationTable;
+  }
   ////////////////////
 
   /**
@@ -458,21 +844,130 @@ public:
    * Set hold down time (time until an invalid route may be deleted)
    * \param t the hold down time
    */
-  void Setholddowntime (Time t)
+  void Setholddowntime (Time t);
+
+private:
+  /// Marker for an unused slot of the open-addressing index
+  static const uint32_t EMPTY_SLOT = 0xffffffff;
+  /**
+   * Hash a destination address onto the open-addressing index
+   * \param dst destination address
+   * \return the home slot of dst
+   */
+  uint32_t
+  HomeSlot (Ipv4Address dst) const
+  {
+    uint32_t h = dst.Get () * 2654435769u;
+    return (h ^ (h >> 16)) & m_slotMask;
+  }
+  /**
+   * Find the index slot holding dst
+   * \param dst destination address
+   * \return the slot number, or EMPTY_SLOT if dst is not in the table
+   */
+  uint32_t
+  FindSlot (Ipv4Address dst) const;
+  /**
+   * Find the position of the record of dst in the record array
+   * \param dst destination address
+   * \return the position, or EMPTY_SLOT if dst has no record
+   */
+  uint32_t
+  FindEntry (Ipv4Address dst) const
+  {
+    uint32_t slot = FindSlot (dst);
+    return slot == EMPTY_SLOT ? EMPTY_SLOT : m_slots[slot];
+  }
+  /**
+   * Remove the record found at the given index slot
+   * \param slot the slot number
+   */
+  void
+  EraseSlot (uint32_t slot);
+  /**
+   * Remove the route of the record found at the given index slot, and the
+   * record itself if it holds no advertisement
+   * \param slot the slot number
+   */
+  void
+  RemoveRoute (uint32_t slot);
+  /**
+   * Remove the advertisement of the record found at the given index slot, and
+   * the record itself if it holds no route
+   * \param slot the slot number
+   */
+  void
+  RemoveAdvertisement (uint32_t slot);
+  /**
+   * Rebuild the index with the given number of slots
+   * \param slots the new number of slots, a power of two
+   */
+  void
+  Rehash (uint32_t slots);
+  /**
+   * Time after which Purge removes the route
+   * \param rt routing table entry
+   * \return the expiry time
+   */
+  Time
+  GetExpiryTime (RoutingTableEntry const & rt) const
   {
-    m_holddownTime = t;
+    return Simulator::Now () - rt.GetLifeTime () + m_holddownTime;
   }
+  /**
+   * Queue the expiry of a route, unless it never expires
+   * \param rt routing table entry
+   */
+  void
+  ScheduleExpiry (RoutingTableEntry const & rt);
+  /// Rebuild the expiry queue from the entries in the table
+  void
+  RebuildExpiryQueue ();
+  /**
+   * Record dst in the list of destinations reached through nextHop
+   * \param nextHop next hop address
+   * \param dst destination address
+   */
+  void
+  LinkNextHop (Ipv4Address nextHop, Ipv4Address dst);
+  /**
+   * Remove dst from the list of destinations reached through nextHop
+   * \param nextHop next hop address
+   * \param dst destination address
+   */
+  void
+  UnlinkNextHop (Ipv4Address nextHop, Ipv4Address dst);
 
-private:
   // Fields
-  /// an entry in the routing table.
-  std::map<Ipv4Address, RoutingTableEntry> m_ipv4AddressEntry;
-  /// an entry in the event table.
-  std::map<Ipv4Address, EventId> m_ipv4Events;
+  /// the destination records, stored contiguously in no particular order.
+  std::vector<DestinationRecord> m_records;
+  /// number of records holding a route
+  uint32_t m_routeCount;
+  /// open-addressing (linear probing) index from destination address to position in m_records.
+  std::vector<uint32_t> m_slots;
+  /// number of index slots minus one
+  uint32_t m_slotMask;
+  /// (expiry time, destination) min-heap. Entries are not removed when a route is refreshed
+  /// or deleted; stale ones are recognised and skipped when they reach the top.
+  std::vector<std::pair<Time, Ipv4Address> > m_expiryQueue;
+  /// destinations reached through each next hop
+  std::unordered_map<Ipv4Address, std::vector<Ipv4Address>, Ipv4AddressHash> m_nextHopIndex;
+  /// destinations whose record holds an advertisement
+  std::unordered_set<Ipv4Address, Ipv4AddressHash> m_pendingAdvertisements;
+  /// destinations whose route moved to a backup next hop, see TakeFailedOver
+  std::vector<Ipv4Address> m_failedOver;
+  /// the routes sorted by destination, as of the last GetRouteSnapshot
+  mutable std::vector<RoutingTableEntry> m_snapshot;
+  /// whether the routes changed since m_snapshot was taken
+  mutable bool m_snapshotStale;
+  /// generation of the routes, see GetGeneration
+  uint64_t m_generation;
   /// hold down time of an expired route
   Time m_holddownTime;
-  
-  std::map<Ipv4Address,std::tuple<uint32_t,uint32_t,float>> m_locationEntry;
+  /// last known location of every node
+  LocationTable m_locationTable;
+  /// neighbours found by IsBetterGeographicNextHop, kept to avoid reallocating them
+  mutable std::vector<Ipv4Address> m_coneNeighbours;
 
 };
 }
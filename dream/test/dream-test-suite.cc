@@ -1,7 +1,21 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
 // Include a header file from your module to test.
+#include "ns3/dream-helper.h"
 #include "ns3/dream-routing-protocol.h"
+#include "ns3/dream-rtable.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -46,6 +60,1644 @@ DreamTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Routing table add, lookup and delete while the hash index grows and shrinks
+class DreamRtableTestCase : public TestCase
+{
+public:
+  DreamRtableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamRtableTestCase::DreamRtableTestCase ()
+  : TestCase ("Dream routing table add, lookup and delete")
+{
+}
+
+void
+DreamRtableTestCase::DoRun (void)
+{
+  dream::RoutingTable table;
+  const uint32_t n = 1000;
+  for (uint32_t i = 1; i <= n; i++)
+    {
+      dream::RoutingTableEntry rt (0, Ipv4Address (0x0a000000 + i), 2 * i, Ipv4InterfaceAddress (), i % 7,
+                                   Ipv4Address (0x0a000000 + (i % 13) + 1));
+      NS_TEST_ASSERT_MSG_EQ (table.AddRoute (rt), true, "Route to a new destination not added");
+      NS_TEST_ASSERT_MSG_EQ (table.AddRoute (rt), false, "Duplicate route added");
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.RoutingTableSize (), n, "Wrong table size");
+  // Delete every third destination
+  for (uint32_t i = 3; i <= n; i += 3)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.DeleteRoute (Ipv4Address (0x0a000000 + i)), true, "Existing route not deleted");
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.DeleteRoute (Ipv4Address (0x0a000000 + 3)), false, "Deleted route deleted twice");
+  for (uint32_t i = 1; i <= n; i++)
+    {
+      dream::RoutingTableEntry rt;
+      bool found = table.LookupRoute (Ipv4Address (0x0a000000 + i), rt);
+      NS_TEST_ASSERT_MSG_EQ (found, (i % 3) != 0, "Lookup disagrees with the set of added routes");
+      if (found)
+        {
+          NS_TEST_ASSERT_MSG_EQ (rt.GetSeqNo (), 2 * i, "Lookup returned the wrong entry");
+          NS_TEST_ASSERT_MSG_EQ (rt.GetNextHop (), Ipv4Address (0x0a000000 + (i % 13) + 1), "Wrong next hop");
+        }
+    }
+  const dream::RoutingTableEntry *found = table.FindRoute (Ipv4Address (0x0a000000 + 10));
+  NS_TEST_ASSERT_MSG_NE (found, (const dream::RoutingTableEntry *) 0, "FindRoute missed an existing route");
+  NS_TEST_ASSERT_MSG_EQ (found->GetSeqNo (), 20u, "FindRoute returned the wrong entry");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (Ipv4Address (0x0a000000 + 9)), (const dream::RoutingTableEntry *) 0,
+                         "FindRoute found a deleted route");
+  // 10.0.0.10 has hop count 3 and is reached through 10.0.0.11
+  Ptr<Ipv4Route> route = table.ResolveRoute (Ipv4Address (0x0a000000 + 10));
+  NS_TEST_ASSERT_MSG_EQ (route, table.FindRoute (Ipv4Address (0x0a000000 + 11))->GetRoute (),
+                         "ResolveRoute did not return the route of the next hop");
+  // 10.0.0.1 has hop count 1 and is its own route
+  route = table.ResolveRoute (Ipv4Address (0x0a000000 + 1));
+  NS_TEST_ASSERT_MSG_EQ (route, table.FindRoute (Ipv4Address (0x0a000000 + 1))->GetRoute (),
+                         "ResolveRoute did not return the route of a neighbour");
+  // 10.0.0.11 is reached through 10.0.0.12, which was deleted above
+  route = table.ResolveRoute (Ipv4Address (0x0a000000 + 11));
+  NS_TEST_ASSERT_MSG_EQ (route, Ptr<Ipv4Route> (), "ResolveRoute resolved through a deleted next hop");
+
+  // Invalidate every route through 10.0.0.3
+  std::map<Ipv4Address, dream::RoutingTableEntry> through;
+  table.GetListOfDestinationWithNextHop (Ipv4Address (0x0a000003), through);
+  std::vector<dream::RoutingTableEntry> removed;
+  table.DeleteRoutesWithNextHop (Ipv4Address (0x0a000003), removed);
+  NS_TEST_ASSERT_MSG_EQ (removed.size (), through.size (), "Deleted routes differ from the listed ones");
+  NS_TEST_ASSERT_MSG_EQ (removed.size (), 51u, "Wrong number of routes through the next hop");
+  for (std::vector<dream::RoutingTableEntry>::const_iterator i = removed.begin (); i != removed.end (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (through.count (i->GetDestination ()), 1u, "Deleted a route not listed");
+      NS_TEST_ASSERT_MSG_EQ (table.FindRoute (i->GetDestination ()), (const dream::RoutingTableEntry *) 0,
+                             "Route through the next hop not deleted");
+    }
+  table.GetListOfDestinationWithNextHop (Ipv4Address (0x0a000003), through);
+  NS_TEST_ASSERT_MSG_EQ (through.empty (), true, "Routes through the next hop left behind");
+
+  dream::RoutingTableEntry updated (0, Ipv4Address (0x0a000004), 100);
+  NS_TEST_ASSERT_MSG_EQ (table.Update (updated), true, "Existing route not updated");
+  dream::RoutingTableEntry rt;
+  table.LookupRoute (Ipv4Address (0x0a000004), rt);
+  NS_TEST_ASSERT_MSG_EQ (rt.GetSeqNo (), 100u, "Update not visible to lookup");
+  table.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (table.RoutingTableSize (), 0u, "Table not empty after Clear");
+  NS_TEST_ASSERT_MSG_EQ (table.LookupRoute (Ipv4Address (0x0a000001), rt), false, "Lookup succeeded after Clear");
+}
+
+// Purge removes expired routes together with the routes depending on them
+class DreamRtablePurgeTestCase : public TestCase
+{
+public:
+  DreamRtablePurgeTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamRtablePurgeTestCase::DreamRtablePurgeTestCase ()
+  : TestCase ("Dream routing table purge of expired routes and their dependents")
+{
+}
+
+void
+DreamRtablePurgeTestCase::DoRun (void)
+{
+  dream::RoutingTable table;
+  table.Setholddowntime (Seconds (10));
+  Ipv4Address a ("10.0.0.1"), b ("10.0.0.2"), c ("10.0.0.3"), d ("10.0.0.4");
+  // a is a stale neighbour, b a fresh one; c is reached through a, d through b
+  dream::RoutingTableEntry ra (0, a, 2, Ipv4InterfaceAddress (), 1, a, Simulator::Now () - Seconds (20));
+  dream::RoutingTableEntry rb (0, b, 2, Ipv4InterfaceAddress (), 1, b, Simulator::Now ());
+  dream::RoutingTableEntry rc (0, c, 2, Ipv4InterfaceAddress (), 2, a, Simulator::Now ());
+  dream::RoutingTableEntry rd (0, d, 2, Ipv4InterfaceAddress (), 2, b, Simulator::Now ());
+  table.AddRoute (ra);
+  table.AddRoute (rb);
+  table.AddRoute (rc);
+  table.AddRoute (rd);
+  // Moving d behind a through a copy of its entry must reach the table only through Update
+  dream::RoutingTableEntry moved;
+  table.LookupRoute (d, moved);
+  moved.SetNextHop (a);
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (d)->GetNextHop (), b, "Next hop changed without Update");
+  table.Update (moved);
+
+  std::map<Ipv4Address, dream::RoutingTableEntry> removed;
+  table.Purge (removed);
+  NS_TEST_ASSERT_MSG_EQ (removed.size (), 3u, "Wrong number of purged routes");
+  NS_TEST_ASSERT_MSG_EQ (removed.count (a), 1u, "Expired route not purged");
+  NS_TEST_ASSERT_MSG_EQ (removed.count (c), 1u, "Dependent route not purged");
+  NS_TEST_ASSERT_MSG_EQ (removed.count (d), 1u, "Route moved behind the expired next hop not purged");
+  NS_TEST_ASSERT_MSG_NE (table.FindRoute (b), (const dream::RoutingTableEntry *) 0, "Fresh route purged");
+  Time next;
+  NS_TEST_ASSERT_MSG_EQ (table.GetNextExpiry (next), true, "No expiry queued for the fresh route");
+  NS_TEST_ASSERT_MSG_EQ (next, Simulator::Now () + Seconds (10), "Wrong next expiry");
+
+  // Refreshing a route moves its expiry
+  dream::RoutingTableEntry refreshed (0, b, 4, Ipv4InterfaceAddress (), 1, b, Simulator::Now () - Seconds (20));
+  table.Update (refreshed);
+  removed.clear ();
+  table.Purge (removed);
+  NS_TEST_ASSERT_MSG_EQ (removed.count (b), 1u, "Route aged by Update not purged");
+  NS_TEST_ASSERT_MSG_EQ (table.RoutingTableSize (), 0u, "Table not empty");
+}
+
+// Settling deadlines of the advertisements behind the triggered updates
+class DreamRtableSettlingTestCase : public TestCase
+{
+public:
+  DreamRtableSettlingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamRtableSettlingTestCase::DreamRtableSettlingTestCase ()
+  : TestCase ("Dream routing table settling deadlines")
+{
+}
+
+void
+DreamRtableSettlingTestCase::DoRun (void)
+{
+  dream::RoutingTable table;
+  Ipv4Address a ("10.0.0.1"), b ("10.0.0.2"), c ("10.0.0.3");
+  Time next;
+  NS_TEST_ASSERT_MSG_EQ (table.GetNextSettlingDeadline (next), false, "Settling deadline without routes");
+  table.AddAdvertisement (dream::RoutingTableEntry (0, a, 2, Ipv4InterfaceAddress (), 1, a, Simulator::Now ()));
+  table.AddAdvertisement (dream::RoutingTableEntry (0, b, 2, Ipv4InterfaceAddress (), 1, b, Simulator::Now ()));
+  table.AddAdvertisement (dream::RoutingTableEntry (0, c, 2, Ipv4InterfaceAddress (), 1, c, Simulator::Now ()));
+  table.SetSettlingDeadline (*table.FindRecord (a), Simulator::Now () + Seconds (5));
+  table.SetSettlingDeadline (*table.FindRecord (b), Simulator::Now () + Seconds (2));
+  table.SetSettlingDeadline (*table.FindRecord (c), Simulator::Now () - Seconds (1));
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (a)->IsSettling (), true, "Advertisement not settling");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (c)->IsSettling (), false, "Settling time over but advertisement still settling");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNextSettlingDeadline (next), true, "No settling deadline");
+  NS_TEST_ASSERT_MSG_EQ (next, Simulator::Now () + Seconds (2), "Wrong next settling deadline");
+
+  // A new deadline replaces the former one
+  table.SetSettlingDeadline (*table.FindRecord (b), Simulator::Now () + Seconds (8));
+  table.GetNextSettlingDeadline (next);
+  NS_TEST_ASSERT_MSG_EQ (next, Simulator::Now () + Seconds (5), "Replaced deadline still used");
+  NS_TEST_ASSERT_MSG_EQ (table.CancelSettling (*table.FindRecord (a)), true, "Settling not cancelled");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (a)->IsSettling (), false, "Cancelled advertisement still settling");
+  table.GetNextSettlingDeadline (next);
+  NS_TEST_ASSERT_MSG_EQ (next, Simulator::Now () + Seconds (8), "Cancelled deadline still used");
+
+  // The advertisement takes its settling time along when it is deleted
+  table.DeleteAdvertisement (*table.FindRecord (b));
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (b), (dream::DestinationRecord *) 0, "Empty record left in the table");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNextSettlingDeadline (next), false, "Deadline of a deleted advertisement still used");
+}
+
+// A destination has one record holding its route and its pending advertisement
+class DreamRtableRecordTestCase : public TestCase
+{
+public:
+  DreamRtableRecordTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamRtableRecordTestCase::DreamRtableRecordTestCase ()
+  : TestCase ("Dream routing table destination records")
+{
+}
+
+void
+DreamRtableRecordTestCase::DoRun (void)
+{
+  dream::RoutingTable table;
+  table.Setholddowntime (Seconds (10));
+  Ipv4Address a ("10.0.0.1"), b ("10.0.0.2"), c ("10.0.0.3"), d ("10.0.0.4"), e ("10.0.0.5");
+  // a and b are advertised, c is not, d is settling and e is invalid
+  dream::RoutingTableEntry ra (0, a, 2, Ipv4InterfaceAddress (), 1, a, Simulator::Now ());
+  dream::RoutingTableEntry rb (0, b, 4, Ipv4InterfaceAddress (), 2, a, Simulator::Now ());
+  dream::RoutingTableEntry rc (0, c, 2, Ipv4InterfaceAddress (), 1, c, Simulator::Now ());
+  dream::RoutingTableEntry rd (0, d, 2, Ipv4InterfaceAddress (), 1, d, Simulator::Now ());
+  dream::RoutingTableEntry re (0, e, 3, Ipv4InterfaceAddress (), 1, e, Simulator::Now ());
+  ra.SetEntriesChanged (true);
+  rb.SetEntriesChanged (true);
+  rd.SetEntriesChanged (true);
+  re.SetEntriesChanged (true);
+  re.SetFlag (dream::INVALID);
+  table.AddRoute (ra);
+  table.AddRoute (rb);
+  table.AddRoute (rc);
+  table.AddRoute (rd);
+  table.AddAdvertisement (ra);
+  table.AddAdvertisement (rb);
+  table.AddAdvertisement (rd);
+  table.AddAdvertisement (re);
+  table.SetSettlingDeadline (*table.FindRecord (d), Simulator::Now () + Seconds (1));
+  NS_TEST_ASSERT_MSG_EQ (table.RoutingTableSize (), 4u, "Wrong number of routes");
+  NS_TEST_ASSERT_MSG_EQ (table.PendingAdvertisementsSize (), 4u, "Wrong number of advertisements");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (e), (const dream::RoutingTableEntry *) 0, "Advertisement seen as a route");
+  NS_TEST_ASSERT_MSG_EQ (table.AddRoute (ra), false, "Route added twice");
+  NS_TEST_ASSERT_MSG_EQ (table.AddAdvertisement (ra), false, "Advertisement added twice");
+
+  // The route and the advertisement of a record change independently
+  dream::DestinationRecord *record = table.FindRecord (b);
+  rb.SetEntriesChanged (false);
+  table.SetAdvertisement (*record, rb);
+  rc.SetEntriesChanged (true);
+  table.SetAdvertisement (*table.FindRecord (c), rc);
+  dream::RoutingTableEntry moved = rb;
+  moved.SetNextHop (c);
+  table.SetRoute (*table.FindRecord (b), moved);
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (b)->GetNextHop (), c, "Route not replaced");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (b)->GetAdvertisement ().GetNextHop (), a, "Advertisement changed with the route");
+  std::map<Ipv4Address, dream::RoutingTableEntry> dsts;
+  table.GetListOfDestinationWithNextHop (c, dsts);
+  NS_TEST_ASSERT_MSG_EQ (dsts.count (b), 1u, "Next hop index not updated");
+
+  std::vector<dream::RoutingTableEntry> ready;
+  table.TakeChangedRoutes (ready);
+  NS_TEST_ASSERT_MSG_EQ (ready.size (), 2u, "Wrong number of routes ready to be advertised");
+  std::vector<Ipv4Address> taken;
+  for (std::vector<dream::RoutingTableEntry>::const_iterator i = ready.begin (); i != ready.end (); ++i)
+    {
+      taken.push_back (i->GetDestination ());
+    }
+  NS_TEST_ASSERT_MSG_EQ (std::count (taken.begin (), taken.end (), a), 1, "Changed advertisement not taken");
+  NS_TEST_ASSERT_MSG_EQ (std::count (taken.begin (), taken.end (), c), 1, "Advertisement changed by SetAdvertisement not taken");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (a)->HasAdvertisement (), false, "Taken advertisement left in the table");
+  NS_TEST_ASSERT_MSG_NE (table.FindRoute (a), (const dream::RoutingTableEntry *) 0, "Route taken with its advertisement");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (b)->HasAdvertisement (), true, "Unchanged advertisement taken");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (d)->HasAdvertisement (), true, "Settling advertisement taken");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (e)->HasAdvertisement (), true, "Invalid advertisement taken");
+  NS_TEST_ASSERT_MSG_EQ (table.PendingAdvertisementsSize (), 3u, "Wrong number of advertisements left");
+
+  // A withdrawn route leaves its advertisement behind
+  table.DeleteRoute (d);
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (d), (const dream::RoutingTableEntry *) 0, "Deleted route still found");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (d)->IsSettling (), true, "Advertisement deleted with the route");
+  NS_TEST_ASSERT_MSG_EQ (table.RoutingTableSize (), 3u, "Wrong number of routes left");
+  // and a route learned again does not touch it
+  table.AddRoute (rd);
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (d)->HasAdvertisement (), true, "Advertisement replaced by the route");
+  table.DeleteAdvertisement (*table.FindRecord (e));
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (e), (dream::DestinationRecord *) 0, "Empty record left in the table");
+  NS_TEST_ASSERT_MSG_EQ (table.PendingAdvertisementsSize (), 2u, "Deleted advertisement still pending");
+}
+
+// Periodic dumps walk a sorted snapshot of the routes
+class DreamRtableSnapshotTestCase : public TestCase
+{
+public:
+  DreamRtableSnapshotTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamRtableSnapshotTestCase::DreamRtableSnapshotTestCase ()
+  : TestCase ("Dream routing table route snapshot")
+{
+}
+
+void
+DreamRtableSnapshotTestCase::DoRun (void)
+{
+  dream::RoutingTable table;
+  for (uint32_t i = 20; i > 0; i--)
+    {
+      dream::RoutingTableEntry rt (0, Ipv4Address (0x0a000000 + i), 2, Ipv4InterfaceAddress (), 1,
+                                   Ipv4Address (0x0a000000 + i));
+      table.AddRoute (rt);
+    }
+  // A withdrawn route that is still advertised is not a route
+  table.AddAdvertisement (dream::RoutingTableEntry (0, Ipv4Address (0x0a000063), 3, Ipv4InterfaceAddress (), 1,
+                                                    Ipv4Address (0x0a000063)));
+  const std::vector<dream::RoutingTableEntry> & routes = table.GetRouteSnapshot ();
+  NS_TEST_ASSERT_MSG_EQ (routes.size (), 20u, "Wrong number of routes in the snapshot");
+  for (uint32_t i = 0; i < routes.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (routes[i].GetDestination (), Ipv4Address (0x0a000001 + i), "Snapshot not sorted");
+    }
+
+  // Changes made while walking the snapshot show up in the next one only
+  table.DeleteRoute (Ipv4Address (0x0a000005));
+  dream::RoutingTableEntry changed (0, Ipv4Address (0x0a000007), 4, Ipv4InterfaceAddress (), 2,
+                                    Ipv4Address (0x0a000001));
+  table.Update (changed);
+  NS_TEST_ASSERT_MSG_EQ (routes.size (), 20u, "Snapshot changed under its reader");
+  NS_TEST_ASSERT_MSG_EQ (routes[6].GetSeqNo (), 2u, "Snapshot changed under its reader");
+  const std::vector<dream::RoutingTableEntry> & next = table.GetRouteSnapshot ();
+  NS_TEST_ASSERT_MSG_EQ (next.size (), 19u, "Deleted route still in the snapshot");
+  NS_TEST_ASSERT_MSG_EQ (next[4].GetDestination (), Ipv4Address (0x0a000006), "Deleted route still in the snapshot");
+  NS_TEST_ASSERT_MSG_EQ (next[5].GetSeqNo (), 4u, "Updated route not in the snapshot");
+}
+
+// The route generation tells when a resolved route may be stale
+class DreamRtableGenerationTestCase : public TestCase
+{
+public:
+  DreamRtableGenerationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamRtableGenerationTestCase::DreamRtableGenerationTestCase ()
+  : TestCase ("Dream routing table generation")
+{
+}
+
+void
+DreamRtableGenerationTestCase::DoRun (void)
+{
+  dream::RoutingTable table;
+  Ipv4Address a ("10.1.1.1");
+  Ipv4Address b ("10.1.1.2");
+  Ipv4Address c ("10.1.1.3");
+  dream::RoutingTableEntry ra (0, a, 2, Ipv4InterfaceAddress (), 1, a, Seconds (10));
+  dream::RoutingTableEntry rb (0, b, 2, Ipv4InterfaceAddress (), 1, b, Seconds (10));
+  dream::RoutingTableEntry rc (0, c, 2, Ipv4InterfaceAddress (), 2, a, Seconds (10));
+  uint64_t generation = table.GetGeneration ();
+  table.AddRoute (ra);
+  table.AddRoute (rb);
+  table.AddRoute (rc);
+  NS_TEST_ASSERT_MSG_NE (table.GetGeneration (), generation, "Added routes left the generation unchanged");
+
+  // Refreshes, advertisements and lookups leave resolved routes as they are
+  generation = table.GetGeneration ();
+  rc.SetSeqNo (4);
+  rc.SetLifeTime (Seconds (20));
+  table.Update (rc);
+  table.AddAdvertisement (rc);
+  table.DeleteAdvertisement (*table.FindRecord (c));
+  dream::RoutingTableEntry found;
+  table.LookupRoute (c, found);
+  table.ResolveRoute (c);
+  NS_TEST_ASSERT_MSG_EQ (table.GetGeneration (), generation, "Refreshed route changed the generation");
+
+  // A new next hop or hop count changes it
+  rc.SetNextHop (b);
+  table.Update (rc);
+  NS_TEST_ASSERT_MSG_NE (table.GetGeneration (), generation, "New next hop left the generation unchanged");
+  generation = table.GetGeneration ();
+  rc.SetHop (3);
+  table.Update (rc);
+  NS_TEST_ASSERT_MSG_NE (table.GetGeneration (), generation, "New hop count left the generation unchanged");
+
+  // and so does a removed route
+  generation = table.GetGeneration ();
+  table.DeleteRoute (b);
+  NS_TEST_ASSERT_MSG_NE (table.GetGeneration (), generation, "Deleted route left the generation unchanged");
+  generation = table.GetGeneration ();
+  table.Clear ();
+  NS_TEST_ASSERT_MSG_NE (table.GetGeneration (), generation, "Cleared table left the generation unchanged");
+}
+
+// Routes fall over to their ranked backup next hops
+class DreamRtableBackupTestCase : public TestCase
+{
+public:
+  DreamRtableBackupTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamRtableBackupTestCase::DreamRtableBackupTestCase ()
+  : TestCase ("Dream routing table backup next hops")
+{
+}
+
+void
+DreamRtableBackupTestCase::DoRun (void)
+{
+  dream::RoutingTable table;
+  table.Setholddowntime (Seconds (10));
+  Ipv4Address n1 ("10.0.0.1"), n2 ("10.0.0.2"), n3 ("10.0.0.3"), n4 ("10.0.0.4"), n5 ("10.0.0.5");
+  Ipv4Address x ("10.0.1.1"), y ("10.0.1.2"), z ("10.0.1.3");
+  Ipv4Address neighbors[] = { n1, n2, n3, n4, n5 };
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      dream::RoutingTableEntry rt (0, neighbors[i], 2, Ipv4InterfaceAddress (), 1, neighbors[i], Simulator::Now ());
+      table.AddRoute (rt);
+    }
+  dream::RoutingTableEntry rx (0, x, 2, Ipv4InterfaceAddress (), 3, n1, Simulator::Now ());
+  dream::RoutingTableEntry ry (0, y, 2, Ipv4InterfaceAddress (), 2, n1, Simulator::Now ());
+  table.AddRoute (rx);
+  table.AddRoute (ry);
+
+  // Ranked by hop count, the most recent first among equals; the next hop in use is no backup
+  dream::DestinationRecord *record = table.FindRecord (x);
+  table.AddBackup (*record, n2, 3);
+  table.AddBackup (*record, n3, 4);
+  table.AddBackup (*record, n4, 3);
+  table.AddBackup (*record, n1, 3);
+  table.AddBackup (*record, n5, 5);
+  NS_TEST_ASSERT_MSG_EQ (record->GetNBackups (), 3u, "Wrong number of backups");
+  NS_TEST_ASSERT_MSG_EQ (record->GetBackup (0).nextHop, n4, "Backups not ranked");
+  NS_TEST_ASSERT_MSG_EQ (record->GetBackup (1).nextHop, n2, "Backups not ranked");
+  NS_TEST_ASSERT_MSG_EQ (record->GetBackup (2).nextHop, n3, "Backups not ranked");
+  // Learning a backup again moves it
+  table.AddBackup (*record, n3, 3);
+  NS_TEST_ASSERT_MSG_EQ (record->GetNBackups (), 3u, "Backup kept twice");
+  NS_TEST_ASSERT_MSG_EQ (record->GetBackup (0).nextHop, n3, "Backup learned again not moved");
+
+  // Losing n1 moves x to the best backup that is still a neighbour, and deletes the routes without backups
+  table.DeleteRoute (n3);
+  uint64_t generation = table.GetGeneration ();
+  std::vector<dream::RoutingTableEntry> removed;
+  uint32_t moved = table.FailOverRoutesWithNextHop (n1, removed);
+  NS_TEST_ASSERT_MSG_EQ (moved, 1u, "Wrong number of routes moved to a backup");
+  NS_TEST_ASSERT_MSG_EQ (removed.size (), 2u, "Wrong number of routes deleted");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (y), (const dream::RoutingTableEntry *) 0, "Route without backup kept");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (x)->GetNextHop (), n4, "Route not moved to its best backup");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (x)->GetHop (), 3u, "Wrong hop count through the backup");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (x)->GetNBackups (), 1u, "Used backup left in the list");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRecord (x)->GetBackup (0).nextHop, n2, "Wrong backup left");
+  NS_TEST_ASSERT_MSG_NE (table.GetGeneration (), generation, "Moved route left the generation unchanged");
+  std::map<Ipv4Address, dream::RoutingTableEntry> dsts;
+  table.GetListOfDestinationWithNextHop (n4, dsts);
+  NS_TEST_ASSERT_MSG_EQ (dsts.count (x), 1u, "Next hop index not updated");
+  std::vector<Ipv4Address> failedOver;
+  table.TakeFailedOver (failedOver);
+  NS_TEST_ASSERT_MSG_EQ (failedOver.size (), 1u, "Moved route not reported");
+  NS_TEST_ASSERT_MSG_EQ (failedOver[0], x, "Wrong moved route reported");
+
+  // The dependents of an expired next hop fall over too
+  dream::RoutingTableEntry rz (0, z, 2, Ipv4InterfaceAddress (), 2, n4, Simulator::Now ());
+  table.AddRoute (rz);
+  table.AddBackup (*table.FindRecord (z), n5, 2);
+  dream::RoutingTableEntry stale (0, n4, 2, Ipv4InterfaceAddress (), 1, n4, Simulator::Now () - Seconds (20));
+  table.Update (stale);
+  std::map<Ipv4Address, dream::RoutingTableEntry> purged;
+  NS_TEST_ASSERT_MSG_EQ (table.Purge (purged), 2u, "Dependents of the expired next hop not moved");
+  NS_TEST_ASSERT_MSG_EQ (purged.size (), 1u, "Wrong number of purged routes");
+  NS_TEST_ASSERT_MSG_EQ (purged.count (n4), 1u, "Expired route not purged");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (x)->GetNextHop (), n2, "Route not moved to its backup");
+  NS_TEST_ASSERT_MSG_EQ (table.FindRoute (z)->GetNextHop (), n5, "Route not moved to its backup");
+  failedOver.clear ();
+  table.TakeFailedOver (failedOver);
+  NS_TEST_ASSERT_MSG_EQ (failedOver.size (), 2u, "Routes moved by Purge not reported");
+
+  // Clearing the table forgets the routes moved since the last report
+  table.AddBackup (*table.FindRecord (x), n5, 3);
+  removed.clear ();
+  NS_TEST_ASSERT_MSG_EQ (table.FailOverRoutesWithNextHop (n2, removed), 1u, "Route not moved to its backup");
+  table.Clear ();
+  failedOver.clear ();
+  table.TakeFailedOver (failedOver);
+  NS_TEST_ASSERT_MSG_EQ (failedOver.size (), 0u, "Moved route reported after the table was cleared");
+}
+
+class DreamLocationTestCase : public TestCase
+{
+public:
+  DreamLocationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamLocationTestCase::DreamLocationTestCase ()
+  : TestCase ("Dream location table grid and aging")
+{
+}
+
+/**
+ * Whether a node is among the nodes around a point
+ * \param table the location table
+ * \param x position in x axis
+ * \param y position in y axis
+ * \param node the node
+ * \return true if GetNodesAround returns the node
+ */
+static bool
+IsAround (dream::LocationTable const & table, double x, double y, Ipv4Address node)
+{
+  std::vector<Ipv4Address> nodes;
+  table.GetNodesAround (x, y, nodes);
+  return std::find (nodes.begin (), nodes.end (), node) != nodes.end ();
+}
+
+void
+DreamLocationTestCase::DoRun (void)
+{
+  dream::RoutingTable table;
+  dream::LocationTable & locations = table.GetLocationTable ();
+  Ipv4Address self ("10.0.0.1"), near ("10.0.0.2"), nearer ("10.0.0.3"), far ("10.0.0.4"), dst ("10.0.0.5");
+  table.AddMobilityData (self, 1000, 1000, 20);
+  table.AddMobilityData (near, 1100, 1000, 20);
+  table.AddMobilityData (nearer, 900, 1000, 20);
+  table.AddMobilityData (far, 5000, 1000, 20);
+  table.AddMobilityData (dst, 2000, 1000, 20);
+  std::vector<Ipv4Address> around;
+  locations.GetNodesAround (1000, 1000, around);
+  NS_TEST_ASSERT_MSG_EQ (around.size (), 3u, "Wrong number of nodes around self");
+  NS_TEST_ASSERT_MSG_EQ (IsAround (locations, 1000, 1000, far), false, "Far node found around self");
+
+  // Moving a node updates its grid cell in place
+  table.AddMobilityData (nearer, 1150, 1000, 20);
+  NS_TEST_ASSERT_MSG_EQ (locations.GetSize (), 5u, "Location update added a node");
+  NS_TEST_ASSERT_MSG_EQ (IsAround (locations, 1000, 1000, nearer), true, "Moved node lost");
+  // Out of the cells around self
+  table.AddMobilityData (nearer, 4900, 1000, 20);
+  NS_TEST_ASSERT_MSG_EQ (IsAround (locations, 1000, 1000, nearer), false, "Node out of range found");
+  NS_TEST_ASSERT_MSG_EQ (IsAround (locations, 5000, 1000, nearer), true, "Node not found in its new cell");
+  double x, y;
+  float v;
+  NS_TEST_ASSERT_MSG_EQ (locations.Lookup (nearer, x, y, v), true, "Node location lost");
+  NS_TEST_ASSERT_MSG_EQ (x, 4900, "Wrong location");
+
+  // Larger cells reach farther
+  locations.SetCellSize (3000);
+  NS_TEST_ASSERT_MSG_EQ (IsAround (locations, 1000, 1000, far), true, "Cell size change not applied");
+  locations.SetCellSize (250);
+
+  // Only the locations heard from recently are kept
+  table.Setholddowntime (Seconds (5));
+  Simulator::Schedule (Seconds (10), &dream::RoutingTable::AddMobilityData, &table, near, 1200u, 1000u, 20.0f);
+  Simulator::Schedule (Seconds (10), &dream::RoutingTable::AddMobilityData, &table, far, 5100u, 1000u, 20.0f);
+  Simulator::Stop (Seconds (11));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (table.PurgeLocations (), 3u, "Wrong number of locations purged");
+  NS_TEST_ASSERT_MSG_EQ (locations.GetSize (), 2u, "Wrong number of locations kept");
+  NS_TEST_ASSERT_MSG_EQ (locations.Lookup (self, x, y, v), false, "Stale location kept");
+  NS_TEST_ASSERT_MSG_EQ (locations.Lookup (far, x, y, v), true, "Fresh location purged");
+  NS_TEST_ASSERT_MSG_EQ (x, 5100, "Wrong location after a purge");
+  NS_TEST_ASSERT_MSG_EQ (IsAround (locations, 1000, 1000, near), true, "Kept node lost from its cell");
+  NS_TEST_ASSERT_MSG_EQ (IsAround (locations, 5000, 1000, far), true, "Kept node lost from its cell");
+  NS_TEST_ASSERT_MSG_EQ (IsAround (locations, 5000, 1000, nearer), false, "Purged node left in its cell");
+  Simulator::Destroy ();
+}
+
+class DreamConeTestCase : public TestCase
+{
+public:
+  DreamConeTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamConeTestCase::DreamConeTestCase ()
+  : TestCase ("Dream expected-zone cone selection")
+{
+}
+
+/// Angle based test of a single point, used as the reference for LocationTable::SelectInCone
+static bool
+ScalarInCone (double px, double py, double sx, double sy, double dx, double dy, double r, double & margin)
+{
+  double distance = std::sqrt ((dx - sx) * (dx - sx) + (dy - sy) * (dy - sy));
+  if (r >= distance)
+    {
+      margin = 1;
+      return true;
+    }
+  double alpha = std::asin (r / distance);
+  double theta = std::atan2 (dy - sy, dx - sx);
+  double phi = std::atan2 (py - sy, px - sx);
+  double angle = std::fabs (std::remainder (phi - theta, 2 * M_PI));
+  margin = std::fabs (angle - alpha);
+  return angle <= alpha;
+}
+
+void
+DreamConeTestCase::DoRun (void)
+{
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  const uint32_t n = 1000;
+  std::vector<double> x (n), y (n);
+  std::vector<uint8_t> inCone (n);
+  for (uint32_t trial = 0; trial < 100; trial++)
+    {
+      double sx = rng->GetValue (0, 1000), sy = rng->GetValue (0, 1000);
+      double dx = rng->GetValue (0, 1000), dy = rng->GetValue (0, 1000);
+      double r = rng->GetValue (0, 600);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          x[i] = rng->GetValue (0, 1000);
+          y[i] = rng->GetValue (0, 1000);
+        }
+      uint32_t count = dream::LocationTable::SelectInCone (x.data (), y.data (), n, sx, sy, dx, dy, r, inCone.data ());
+      uint32_t marked = 0;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          double margin;
+          bool in = ScalarInCone (x[i], y[i], sx, sy, dx, dy, r, margin);
+          marked += inCone[i];
+          // Points on the boundary may fall on either side due to rounding
+          if (margin > 1e-9)
+            {
+              NS_TEST_ASSERT_MSG_EQ ((bool) inCone[i], in, "Cone selection differs from the angle based test");
+            }
+        }
+      NS_TEST_ASSERT_MSG_EQ (count, marked, "Wrong number of points in the cone");
+    }
+
+  // Only 1-hop neighbours around self in the cone are returned
+  dream::RoutingTable table;
+  Ipv4Address self ("10.0.0.1"), ahead ("10.0.0.2"), behind ("10.0.0.3"), twoHops ("10.0.0.4"), dst ("10.0.0.5");
+  table.AddMobilityData (self, 1000, 1000, 20);
+  table.AddMobilityData (ahead, 1100, 1000, 20);
+  table.AddMobilityData (behind, 900, 1000, 20);
+  table.AddMobilityData (twoHops, 1200, 1000, 20);
+  table.AddMobilityData (dst, 2000, 1000, 20);
+  dream::RoutingTableEntry ra (0, ahead, 2, Ipv4InterfaceAddress (), 1, ahead);
+  dream::RoutingTableEntry rb (0, behind, 2, Ipv4InterfaceAddress (), 1, behind);
+  dream::RoutingTableEntry rt (0, twoHops, 2, Ipv4InterfaceAddress (), 2, ahead);
+  table.AddRoute (ra);
+  table.AddRoute (rb);
+  table.AddRoute (rt);
+  std::vector<Ipv4Address> neighbours;
+  table.GetNeighboursInCone (dst, self, neighbours);
+  NS_TEST_ASSERT_MSG_EQ (neighbours.size (), 1u, "Wrong number of neighbours in the cone");
+  NS_TEST_ASSERT_MSG_EQ (neighbours[0], ahead, "Wrong neighbour in the cone");
+  NS_TEST_ASSERT_MSG_EQ (table.IsBetterGeographicNextHop (dst, self, ahead, behind), true,
+                         "Neighbour in the cone not preferred");
+  NS_TEST_ASSERT_MSG_EQ (table.IsBetterGeographicNextHop (dst, self, behind, ahead), false,
+                         "Neighbour out of the cone preferred");
+}
+
+class DreamUpdateHeaderTestCase : public TestCase
+{
+public:
+  DreamUpdateHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamUpdateHeaderTestCase::DreamUpdateHeaderTestCase ()
+  : TestCase ("Dream update header serialization")
+{
+}
+
+void
+DreamUpdateHeaderTestCase::DoRun (void)
+{
+  dream::DreamUpdateHeader sent (Ipv4Address ("10.1.1.1"), 1234, 5678, 19.5);
+  const uint32_t n = 50;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      sent.AddRecord (dream::DreamHeader (Ipv4Address (0x0a010100 + i), i % 10, 2 * i));
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (sent);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), dream::DreamUpdateHeader::SENDER_BLOCK_SIZE + n * dream::DreamHeader::RECORD_SIZE,
+                         "Wrong serialized size");
+
+  dream::DreamUpdateHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 0u, "Update not fully deserialized");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t) received.GetVersion (), (uint32_t) dream::DreamUpdateHeader::VERSION, "Wrong version");
+  NS_TEST_ASSERT_MSG_EQ (received.GetSrc (), Ipv4Address ("10.1.1.1"), "Wrong source");
+  NS_TEST_ASSERT_MSG_EQ (received.GetX (), 1234u, "Wrong position in x axis");
+  NS_TEST_ASSERT_MSG_EQ (received.GetY (), 5678u, "Wrong position in y axis");
+  NS_TEST_ASSERT_MSG_EQ (received.GetSpeed (), 19.5, "Wrong speed");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNumRecords (), n, "Wrong number of records");
+  for (uint32_t i = 0; i < n; i++)
+    {
+      const dream::DreamHeader & record = received.GetRecords ()[i];
+      NS_TEST_ASSERT_MSG_EQ (record.GetDst (), Ipv4Address (0x0a010100 + i), "Wrong destination");
+      NS_TEST_ASSERT_MSG_EQ (record.GetHopCount (), i % 10, "Wrong hop count");
+      NS_TEST_ASSERT_MSG_EQ (record.GetDstSeqno (), 2 * i, "Wrong sequence number");
+    }
+}
+
+class DreamPacketQueueTestCase : public TestCase
+{
+public:
+  DreamPacketQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Queue a packet
+   * \param dst the destination of the packet
+   */
+  void EnqueueLater (Ipv4Address dst);
+  /// Check the queue after the first packets expired
+  void CheckExpired ();
+  /**
+   * Create a queue entry
+   * \param dst the destination of the packet
+   * \return the entry
+   */
+  dream::QueueEntry CreateEntry (Ipv4Address dst);
+  /**
+   * Drop callback of the queue
+   * \param entry the dropped entry
+   * \param reason the reason for the drop
+   */
+  void Dropped (dream::QueueEntry const & entry, dream::DropReason reason);
+  /**
+   * Reject callback of the queue
+   * \param entry the refused entry
+   * \param reason the reason for the refusal
+   */
+  void Rejected (dream::QueueEntry const & entry, dream::EnqueueRejectReason reason);
+
+  dream::PacketQueue m_queue; ///< the queue under test
+  uint32_t m_drops[dream::DROP_REASON_COUNT]; ///< drops reported, per reason
+  uint32_t m_rejects[dream::REJECT_REASON_COUNT]; ///< rejects reported, per reason
+  Ipv4Address m_lastDropped; ///< destination of the packet dropped last
+  uint64_t m_lastRejected; ///< UID of the packet refused last
+};
+
+DreamPacketQueueTestCase::DreamPacketQueueTestCase ()
+  : TestCase ("Dream packet queue"),
+    m_lastRejected (0)
+{
+  std::fill (m_drops, m_drops + dream::DROP_REASON_COUNT, 0);
+  std::fill (m_rejects, m_rejects + dream::REJECT_REASON_COUNT, 0);
+}
+
+void
+DreamPacketQueueTestCase::Dropped (dream::QueueEntry const & entry, dream::DropReason reason)
+{
+  m_drops[reason]++;
+  m_lastDropped = entry.GetIpv4Header ().GetDestination ();
+}
+
+void
+DreamPacketQueueTestCase::Rejected (dream::QueueEntry const & entry, dream::EnqueueRejectReason reason)
+{
+  m_rejects[reason]++;
+  m_lastRejected = entry.GetPacket ()->GetUid ();
+}
+
+dream::QueueEntry
+DreamPacketQueueTestCase::CreateEntry (Ipv4Address dst)
+{
+  Ipv4Header header;
+  header.SetDestination (dst);
+  return dream::QueueEntry (Create<Packet> (), header);
+}
+
+void
+DreamPacketQueueTestCase::DoRun (void)
+{
+  m_queue.SetMaxQueueLen (10);
+  m_queue.SetMaxPacketsPerDst (3);
+  m_queue.SetQueueTimeout (Seconds (10));
+  m_queue.SetDropCallback (MakeCallback (&DreamPacketQueueTestCase::Dropped, this));
+  m_queue.SetRejectCallback (MakeCallback (&DreamPacketQueueTestCase::Rejected, this));
+  Ipv4Address a ("10.0.0.1"), b ("10.0.0.2"), c ("10.0.0.3");
+  std::vector<dream::QueueEntry> sent;
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      sent.push_back (CreateEntry (a));
+      NS_TEST_ASSERT_MSG_EQ (m_queue.Enqueue (sent.back ()), i < 3, "Per destination limit not enforced");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_lastRejected, sent[3].GetPacket ()->GetUid (), "Wrong packet reported as refused");
+  NS_TEST_ASSERT_MSG_EQ (m_queue.Enqueue (sent[0]), false, "Duplicate packet queued");
+  NS_TEST_ASSERT_MSG_EQ (m_lastRejected, sent[0].GetPacket ()->GetUid (), "Wrong duplicate reported");
+  NS_TEST_ASSERT_MSG_EQ (m_rejects[dream::REJECT_DESTINATION_FULL], 1u, "Destination full not reported");
+  NS_TEST_ASSERT_MSG_EQ (m_rejects[dream::REJECT_DUPLICATE], 1u, "Duplicate not reported");
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      dream::QueueEntry entry = CreateEntry (b);
+      m_queue.Enqueue (entry);
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_queue.GetSize (), 6u, "Wrong queue size");
+  NS_TEST_ASSERT_MSG_EQ (m_queue.GetCountForPacketsWithDst (a), 3u, "Wrong count for destination");
+  NS_TEST_ASSERT_MSG_EQ (m_queue.Find (c), false, "Found a destination with no packets");
+
+  dream::QueueEntry entry;
+  NS_TEST_ASSERT_MSG_EQ (m_queue.Dequeue (a, entry), true, "Dequeue failed");
+  NS_TEST_ASSERT_MSG_EQ (entry.GetPacket ()->GetUid (), sent[0].GetPacket ()->GetUid (), "Not the oldest packet");
+  NS_TEST_ASSERT_MSG_EQ (m_queue.Enqueue (sent[0]), true, "Dequeued packet not accepted again");
+  m_queue.DropPacketWithDst (b);
+  NS_TEST_ASSERT_MSG_EQ (m_queue.Find (b), false, "Packets not dropped");
+  NS_TEST_ASSERT_MSG_EQ (m_queue.GetSize (), 3u, "Wrong queue size after drop");
+  NS_TEST_ASSERT_MSG_EQ (m_drops[dream::DROP_QUEUE_FLUSHED], 3u, "Flushed packets not reported");
+  NS_TEST_ASSERT_MSG_EQ (m_lastDropped, b, "Wrong flushed packet reported");
+  m_queue.SetMaxQueueLen (3);
+  entry = CreateEntry (c);
+  NS_TEST_ASSERT_MSG_EQ (m_queue.Enqueue (entry), false, "Queue limit not enforced");
+  NS_TEST_ASSERT_MSG_EQ (m_rejects[dream::REJECT_QUEUE_FULL], 1u, "Queue full not reported");
+  NS_TEST_ASSERT_MSG_EQ (m_lastRejected, entry.GetPacket ()->GetUid (), "Wrong packet reported as refused");
+  m_queue.SetMaxQueueLen (10);
+
+  // The packets queued at 0s expire at 10s, the one queued at 5s at 15s
+  Simulator::Schedule (Seconds (5), &DreamPacketQueueTestCase::EnqueueLater, this, c);
+  Simulator::Schedule (Seconds (11), &DreamPacketQueueTestCase::CheckExpired, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+DreamPacketQueueTestCase::EnqueueLater (Ipv4Address dst)
+{
+  dream::QueueEntry entry = CreateEntry (dst);
+  m_queue.Enqueue (entry);
+}
+
+void
+DreamPacketQueueTestCase::CheckExpired ()
+{
+  NS_TEST_ASSERT_MSG_EQ (m_queue.GetSize (), 1u, "Expired packets not purged");
+  NS_TEST_ASSERT_MSG_EQ (m_queue.Find (Ipv4Address ("10.0.0.1")), false, "Expired destination still found");
+  NS_TEST_ASSERT_MSG_EQ (m_queue.Find (Ipv4Address ("10.0.0.3")), true, "Packet purged before it expired");
+  NS_TEST_ASSERT_MSG_EQ (m_drops[dream::DROP_QUEUE_TIMEOUT], 3u, "Expired packets not reported");
+  NS_TEST_ASSERT_MSG_EQ (m_lastDropped, Ipv4Address ("10.0.0.1"), "Wrong expired packet reported");
+  dream::QueueEntry entry;
+  m_queue.Dequeue (Ipv4Address ("10.0.0.3"), entry);
+  NS_TEST_ASSERT_MSG_EQ (entry.GetEnqueueTime (), Seconds (5), "Wrong enqueue time");
+}
+
+/**
+ * \ingroup dream-test
+ * \ingroup tests
+ *
+ * \brief Dream packet queue policy test case
+ */
+class DreamQueuePolicyTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param policy the queue policy under test
+   * \param name the name of the policy
+   */
+  DreamQueuePolicyTestCase (dream::QueuePolicy policy, std::string name);
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Queue a packet
+   * \param dst the destination of the packet
+   * \param size the size of the packet
+   * \return the UID of the packet if it was queued, 0 otherwise
+   */
+  uint64_t Enqueue (Ipv4Address dst, uint32_t size = 100);
+  /**
+   * Get the UID of the oldest packet queued for a destination
+   * \param dst the destination
+   * \return the UID
+   */
+  uint64_t Oldest (Ipv4Address dst);
+  /**
+   * Drop callback of the queue
+   * \param entry the dropped entry
+   * \param reason the reason for the drop
+   */
+  void Dropped (dream::QueueEntry const & entry, dream::DropReason reason);
+  /**
+   * Reject callback of the queue
+   * \param entry the refused entry
+   * \param reason the reason for the refusal
+   */
+  void Rejected (dream::QueueEntry const & entry, dream::EnqueueRejectReason reason);
+
+  dream::QueuePolicy m_policy; ///< the queue policy under test
+  dream::PacketQueue m_queue; ///< the queue under test
+  std::vector<uint64_t> m_evicted; ///< UIDs of the evicted packets
+  std::vector<dream::EnqueueRejectReason> m_rejects; ///< reasons of the refusals
+  std::vector<Ipv4Address> m_rejectedDsts; ///< destinations of the refused packets
+};
+
+DreamQueuePolicyTestCase::DreamQueuePolicyTestCase (dream::QueuePolicy policy, std::string name)
+  : TestCase ("Dream packet queue " + name + " policy"),
+    m_policy (policy)
+{
+}
+
+uint64_t
+DreamQueuePolicyTestCase::Enqueue (Ipv4Address dst, uint32_t size)
+{
+  Ipv4Header header;
+  header.SetDestination (dst);
+  dream::QueueEntry entry (Create<Packet> (size), header);
+  return m_queue.Enqueue (entry) ? entry.GetPacket ()->GetUid () : 0;
+}
+
+uint64_t
+DreamQueuePolicyTestCase::Oldest (Ipv4Address dst)
+{
+  dream::QueueEntry entry;
+  return m_queue.Dequeue (dst, entry) ? entry.GetPacket ()->GetUid () : 0;
+}
+
+void
+DreamQueuePolicyTestCase::Dropped (dream::QueueEntry const & entry, dream::DropReason reason)
+{
+  NS_TEST_EXPECT_MSG_EQ (reason, dream::DROP_QUEUE_EVICTED, "Unexpected drop reason");
+  m_evicted.push_back (entry.GetPacket ()->GetUid ());
+}
+
+void
+DreamQueuePolicyTestCase::Rejected (dream::QueueEntry const & entry, dream::EnqueueRejectReason reason)
+{
+  m_rejects.push_back (reason);
+  m_rejectedDsts.push_back (entry.GetIpv4Header ().GetDestination ());
+}
+
+void
+DreamQueuePolicyTestCase::DoRun (void)
+{
+  m_queue.SetMaxQueueLen (4);
+  m_queue.SetMaxPacketsPerDst (3);
+  m_queue.SetQueueTimeout (Seconds (10));
+  m_queue.SetQueuePolicy (m_policy);
+  m_queue.SetDropCallback (MakeCallback (&DreamQueuePolicyTestCase::Dropped, this));
+  m_queue.SetRejectCallback (MakeCallback (&DreamQueuePolicyTestCase::Rejected, this));
+  Ipv4Address a ("10.0.0.1"), b ("10.0.0.2"), c ("10.0.0.3");
+
+  // b0 is the oldest packet, a holds the most packets
+  uint64_t b0 = Enqueue (b);
+  uint64_t a0 = Enqueue (a);
+  uint64_t a1 = Enqueue (a);
+  uint64_t a2 = Enqueue (a);
+  NS_TEST_ASSERT_MSG_EQ (m_queue.GetSize (), 4u, "Packets refused below the limits");
+
+  // The limit of destination a is reached
+  uint64_t a3 = Enqueue (a);
+  // The queue is full
+  uint64_t c0 = Enqueue (c);
+  switch (m_policy)
+    {
+    case dream::QUEUE_DROP_TAIL:
+      NS_TEST_ASSERT_MSG_EQ (a3, 0, "Packet over the destination limit queued");
+      NS_TEST_ASSERT_MSG_EQ (c0, 0, "Packet over the queue limit queued");
+      NS_TEST_ASSERT_MSG_EQ (m_evicted.size (), 0u, "Packet evicted");
+      NS_TEST_ASSERT_MSG_EQ (m_rejects.size (), 2u, "Refusals not reported");
+      NS_TEST_ASSERT_MSG_EQ (m_rejects[0], dream::REJECT_DESTINATION_FULL, "Wrong refusal reason");
+      NS_TEST_ASSERT_MSG_EQ (m_rejects[1], dream::REJECT_QUEUE_FULL, "Wrong refusal reason");
+      NS_TEST_ASSERT_MSG_EQ (m_rejectedDsts[0], a, "Wrong packet refused");
+      NS_TEST_ASSERT_MSG_EQ (m_rejectedDsts[1], c, "Wrong packet refused");
+      NS_TEST_ASSERT_MSG_EQ (Oldest (a), a0, "Oldest packet of a not kept");
+      NS_TEST_ASSERT_MSG_EQ (Oldest (b), b0, "Oldest packet of b not kept");
+      break;
+    case dream::QUEUE_DROP_OLDEST:
+      NS_TEST_ASSERT_MSG_NE (a3, 0, "Packet over the destination limit refused");
+      NS_TEST_ASSERT_MSG_NE (c0, 0, "Packet over the queue limit refused");
+      NS_TEST_ASSERT_MSG_EQ (m_rejects.size (), 0u, "Packet refused");
+      NS_TEST_ASSERT_MSG_EQ (m_evicted.size (), 2u, "Wrong number of packets evicted");
+      NS_TEST_ASSERT_MSG_EQ (m_evicted[0], a0, "Oldest packet of the destination not evicted");
+      NS_TEST_ASSERT_MSG_EQ (m_evicted[1], b0, "Oldest packet of the queue not evicted");
+      NS_TEST_ASSERT_MSG_EQ (Oldest (a), a1, "Wrong oldest packet of a");
+      NS_TEST_ASSERT_MSG_EQ (Oldest (b), 0, "Evicted packet still queued");
+      break;
+    case dream::QUEUE_FAIR_SHARE:
+      NS_TEST_ASSERT_MSG_NE (a3, 0, "Packet over the destination limit refused");
+      NS_TEST_ASSERT_MSG_NE (c0, 0, "Packet over the queue limit refused");
+      NS_TEST_ASSERT_MSG_EQ (m_rejects.size (), 0u, "Packet refused");
+      NS_TEST_ASSERT_MSG_EQ (m_evicted.size (), 2u, "Wrong number of packets evicted");
+      NS_TEST_ASSERT_MSG_EQ (m_evicted[0], a0, "Oldest packet of the destination not evicted");
+      NS_TEST_ASSERT_MSG_EQ (m_evicted[1], a1, "Oldest packet of the longest destination not evicted");
+      NS_TEST_ASSERT_MSG_EQ (Oldest (a), a2, "Wrong oldest packet of a");
+      NS_TEST_ASSERT_MSG_EQ (Oldest (b), b0, "Packet of the shortest destination evicted");
+      break;
+    }
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dream-test
+ * \ingroup tests
+ *
+ * \brief Dream packet queue byte limit test case
+ */
+class DreamQueueBytesTestCase : public TestCase
+{
+public:
+  DreamQueueBytesTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Queue a packet
+   * \param queue the queue
+   * \param size the size of the packet
+   * \return true if the packet was queued
+   */
+  bool Enqueue (dream::PacketQueue & queue, uint32_t size);
+};
+
+DreamQueueBytesTestCase::DreamQueueBytesTestCase ()
+  : TestCase ("Dream packet queue byte limit")
+{
+}
+
+bool
+DreamQueueBytesTestCase::Enqueue (dream::PacketQueue & queue, uint32_t size)
+{
+  Ipv4Header header;
+  header.SetDestination (Ipv4Address ("10.0.0.1"));
+  dream::QueueEntry entry (Create<Packet> (size), header);
+  return queue.Enqueue (entry);
+}
+
+void
+DreamQueueBytesTestCase::DoRun (void)
+{
+  dream::QueuePolicy policies[] = { dream::QUEUE_DROP_TAIL, dream::QUEUE_DROP_OLDEST };
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      dream::PacketQueue queue;
+      queue.SetMaxQueueLen (10);
+      queue.SetMaxPacketsPerDst (10);
+      queue.SetQueueTimeout (Seconds (10));
+      queue.SetMaxQueueBytes (250);
+      queue.SetQueuePolicy (policies[i]);
+      NS_TEST_ASSERT_MSG_EQ (Enqueue (queue, 100), true, "Packet refused below the byte limit");
+      NS_TEST_ASSERT_MSG_EQ (Enqueue (queue, 100), true, "Packet refused below the byte limit");
+      NS_TEST_ASSERT_MSG_EQ (Enqueue (queue, 300), false, "Packet larger than the byte limit queued");
+      NS_TEST_ASSERT_MSG_EQ (Enqueue (queue, 100), policies[i] == dream::QUEUE_DROP_OLDEST, "Wrong admission at the byte limit");
+      NS_TEST_ASSERT_MSG_EQ (queue.GetSize (), 2u, "Wrong queue size");
+      NS_TEST_ASSERT_MSG_EQ (queue.GetBytes (), 200u, "Wrong number of bytes queued");
+      dream::QueueEntry entry;
+      queue.Dequeue (Ipv4Address ("10.0.0.1"), entry);
+      NS_TEST_ASSERT_MSG_EQ (queue.GetBytes (), 100u, "Bytes not released by Dequeue");
+    }
+  Simulator::Destroy ();
+}
+
+// DREAM runs on node 0 of a shared channel. The other nodes run no routing protocol,
+// they send hand made updates to node 0.
+class DreamProtocolTestCase : public TestCase
+{
+protected:
+  DreamProtocolTestCase (std::string name);
+  /**
+   * Create the nodes and the channel
+   * \param n the number of nodes
+   * \param dream the helper that installs DREAM on node 0
+   */
+  void CreateNodes (uint32_t n, DreamHelper const & dream);
+  /**
+   * Broadcast an update from one of the nodes without DREAM
+   * \param at the time to send it
+   * \param node the index of the node
+   * \param update the update
+   */
+  void ScheduleUpdate (Time at, uint32_t node, dream::DreamUpdateHeader const & update);
+  /**
+   * Broadcast a packet to the DREAM port from one of the nodes without DREAM
+   * \param at the time to send it
+   * \param node the index of the node
+   * \param packet the packet
+   */
+  void SchedulePacket (Time at, uint32_t node, Ptr<Packet> packet);
+  /**
+   * Append the next hop node 0 uses for dst to m_nextHops
+   * \param dst the destination
+   */
+  void RecordNextHop (Ipv4Address dst);
+  /**
+   * Append the updates one of the nodes without DREAM receives to m_updates
+   * \param node the index of the node
+   */
+  void RecordUpdates (uint32_t node);
+  /**
+   * Send a data packet from node 0 the way the IP layer does, through
+   * RouteOutput and, if it is to be buffered, through RouteInput on the loopback
+   * \param dst the destination
+   */
+  void SendData (Ipv4Address dst);
+  /**
+   * Hand node 0 a data packet received from a neighbour, the way the IP
+   * layer does, through RouteInput on the device of its interface 1
+   * \param origin the source of the packet
+   * \param dst the destination
+   */
+  void ReceiveData (Ipv4Address origin, Ipv4Address dst);
+
+  NodeContainer m_nodes; ///< The nodes, DREAM runs on the first one
+  Ipv4InterfaceContainer m_interfaces; ///< The addresses of the nodes
+  Ptr<dream::DreamRoutingProtocol> m_routing; ///< DREAM on node 0
+  std::vector<Ptr<Socket> > m_sockets; ///< The sockets of the nodes without DREAM, by node index
+  std::vector<Ipv4Address> m_nextHops; ///< The next hops recorded by RecordNextHop
+  /// The updates recorded by RecordUpdates, with the time they were received
+  std::vector<std::pair<Time, dream::DreamUpdateHeader> > m_updates;
+  /// The next hops of the data packets forwarded by DREAM, with the time
+  std::vector<std::pair<Time, Ipv4Address> > m_forwarded;
+  /// The destinations of the data packets received by ReceiveData and delivered locally
+  std::vector<Ipv4Address> m_delivered;
+
+private:
+  void SendPacket (uint32_t node, Ptr<Packet> packet);
+  void ReceiveUpdate (Ptr<Socket> socket);
+  void ForwardData (Ptr<Ipv4Route> route, Ptr<const Packet> packet, const Ipv4Header & header);
+  void DeliverData (Ptr<const Packet> packet, const Ipv4Header & header, uint32_t iif);
+
+  Ipv4Address m_source; ///< The source of the data packet sent or received last
+};
+
+DreamProtocolTestCase::DreamProtocolTestCase (std::string name)
+  : TestCase (name)
+{
+}
+
+void
+DreamProtocolTestCase::CreateNodes (uint32_t n, DreamHelper const & dream)
+{
+  m_nodes.Create (n);
+  SimpleNetDeviceHelper simple;
+  NetDeviceContainer devices = simple.Install (m_nodes);
+  InternetStackHelper internet;
+  for (uint32_t i = 1; i < n; i++)
+    {
+      internet.Install (m_nodes.Get (i));
+    }
+  internet.SetRoutingHelper (dream);
+  internet.Install (m_nodes.Get (0));
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  m_interfaces = address.Assign (devices);
+  m_routing = DynamicCast<dream::DreamRoutingProtocol> (m_nodes.Get (0)->GetObject<Ipv4> ()->GetRoutingProtocol ());
+  m_sockets.resize (n);
+  for (uint32_t i = 1; i < n; i++)
+    {
+      m_sockets[i] = Socket::CreateSocket (m_nodes.Get (i), UdpSocketFactory::GetTypeId ());
+      m_sockets[i]->SetAllowBroadcast (true);
+      m_sockets[i]->Bind (InetSocketAddress (Ipv4Address::GetAny (), dream::DreamRoutingProtocol::DREAM_PORT));
+    }
+}
+
+void
+DreamProtocolTestCase::ScheduleUpdate (Time at, uint32_t node, dream::DreamUpdateHeader const & update)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (update);
+  SchedulePacket (at, node, packet);
+}
+
+void
+DreamProtocolTestCase::SchedulePacket (Time at, uint32_t node, Ptr<Packet> packet)
+{
+  Simulator::Schedule (at, &DreamProtocolTestCase::SendPacket, this, node, packet);
+}
+
+void
+DreamProtocolTestCase::SendPacket (uint32_t node, Ptr<Packet> packet)
+{
+  m_sockets[node]->SendTo (packet, 0, InetSocketAddress (Ipv4Address ("10.1.1.255"),
+                                                         dream::DreamRoutingProtocol::DREAM_PORT));
+}
+
+void
+DreamProtocolTestCase::RecordNextHop (Ipv4Address dst)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  Ipv4Header header;
+  header.SetDestination (dst);
+  Socket::SocketErrno err;
+  Ptr<Ipv4Route> route = m_routing->RouteOutput (packet, header, 0, err);
+  m_nextHops.push_back (route ? route->GetGateway () : Ipv4Address ());
+}
+
+void
+DreamProtocolTestCase::RecordUpdates (uint32_t node)
+{
+  m_sockets[node]->SetRecvCallback (MakeCallback (&DreamProtocolTestCase::ReceiveUpdate, this));
+}
+
+void
+DreamProtocolTestCase::SendData (Ipv4Address dst)
+{
+  Ptr<Packet> packet = Create<Packet> (64);
+  Ipv4Header header;
+  header.SetDestination (dst);
+  header.SetSource (m_interfaces.GetAddress (0));
+  m_source = header.GetSource ();
+  Socket::SocketErrno err;
+  Ptr<Ipv4Route> route = m_routing->RouteOutput (packet, header, 0, err);
+  if (route == 0)
+    {
+      return;
+    }
+  if (route->GetGateway () != Ipv4Address ("127.0.0.1"))
+    {
+      ForwardData (route, packet, header);
+      return;
+    }
+  Ptr<Ipv4> ipv4 = m_nodes.Get (0)->GetObject<Ipv4> ();
+  m_routing->RouteInput (packet, header, ipv4->GetNetDevice (0),
+                         MakeCallback (&DreamProtocolTestCase::ForwardData, this),
+                         Ipv4RoutingProtocol::MulticastForwardCallback (),
+                         Ipv4RoutingProtocol::LocalDeliverCallback (),
+                         Ipv4RoutingProtocol::ErrorCallback ());
+}
+
+void
+DreamProtocolTestCase::ForwardData (Ptr<Ipv4Route> route, Ptr<const Packet>, const Ipv4Header & header)
+{
+  NS_TEST_EXPECT_MSG_EQ (header.GetSource (), m_source, "Forwarded a packet the test did not send");
+  m_forwarded.push_back (std::make_pair (Simulator::Now (), route->GetGateway ()));
+}
+
+void
+DreamProtocolTestCase::ReceiveData (Ipv4Address origin, Ipv4Address dst)
+{
+  Ptr<Packet> packet = Create<Packet> (64);
+  Ipv4Header header;
+  header.SetDestination (dst);
+  header.SetSource (origin);
+  m_source = origin;
+  Ptr<Ipv4> ipv4 = m_nodes.Get (0)->GetObject<Ipv4> ();
+  m_routing->RouteInput (packet, header, ipv4->GetNetDevice (1),
+                         MakeCallback (&DreamProtocolTestCase::ForwardData, this),
+                         Ipv4RoutingProtocol::MulticastForwardCallback (),
+                         MakeCallback (&DreamProtocolTestCase::DeliverData, this),
+                         Ipv4RoutingProtocol::ErrorCallback ());
+}
+
+void
+DreamProtocolTestCase::DeliverData (Ptr<const Packet>, const Ipv4Header & header, uint32_t)
+{
+  m_delivered.push_back (header.GetDestination ());
+}
+
+void
+DreamProtocolTestCase::ReceiveUpdate (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      dream::DreamUpdateHeader update;
+      packet->RemoveHeader (update);
+      m_updates.push_back (std::make_pair (Simulator::Now (), update));
+    }
+}
+
+// Two neighbours advertise a destination with the same sequence number and metric
+class DreamGeographicNextHopTestCase : public DreamProtocolTestCase
+{
+public:
+  DreamGeographicNextHopTestCase (bool enable);
+
+private:
+  virtual void DoRun (void);
+  bool m_enable;
+};
+
+DreamGeographicNextHopTestCase::DreamGeographicNextHopTestCase (bool enable)
+  : DreamProtocolTestCase (enable ? "Dream geographic next hop" : "Dream next hop without geography"),
+    m_enable (enable)
+{
+}
+
+void
+DreamGeographicNextHopTestCase::DoRun (void)
+{
+  DreamHelper dream;
+  dream.Set ("EnableGeographicNextHop", BooleanValue (m_enable));
+  dream.Set ("LocationCellSize", DoubleValue (500));
+  CreateNodes (5, dream);
+  Ipv4Address far = m_interfaces.GetAddress (1);
+  Ipv4Address near = m_interfaces.GetAddress (2);
+  Ipv4Address aside = m_interfaces.GetAddress (3);
+  Ipv4Address dst = m_interfaces.GetAddress (4);
+  // The destination is heard once, without routes, far to the east
+  ScheduleUpdate (Seconds (1), 4, dream::DreamUpdateHeader (dst, 1000, 0, 10));
+  // Beside this node, out of the cone toward the destination
+  dream::DreamUpdateHeader fromFar (far, 0, 200);
+  fromFar.AddRecord (dream::DreamHeader (far, 1, 2));
+  fromFar.AddRecord (dream::DreamHeader (dst, 2, 2));
+  ScheduleUpdate (Seconds (2), 1, fromFar);
+  // On the way to the destination
+  dream::DreamUpdateHeader fromNear (near, 200, 0);
+  fromNear.AddRecord (dream::DreamHeader (near, 1, 2));
+  fromNear.AddRecord (dream::DreamHeader (dst, 2, 2));
+  ScheduleUpdate (Seconds (3), 2, fromNear);
+  // Closer to the destination than near, but out of the cone
+  dream::DreamUpdateHeader fromAside (aside, 400, 100);
+  fromAside.AddRecord (dream::DreamHeader (aside, 1, 2));
+  fromAside.AddRecord (dream::DreamHeader (dst, 2, 2));
+  ScheduleUpdate (Seconds (3.5), 3, fromAside);
+  Simulator::Schedule (Seconds (2.5), &DreamGeographicNextHopTestCase::RecordNextHop, this, dst);
+  Simulator::Schedule (Seconds (4), &DreamGeographicNextHopTestCase::RecordNextHop, this, dst);
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_nextHops.size (), 2u, "Next hops not recorded");
+  NS_TEST_ASSERT_MSG_EQ (m_nextHops[0], far, "First advertiser not used as next hop");
+  NS_TEST_ASSERT_MSG_EQ (m_nextHops[1], m_enable ? near : far, "Wrong next hop after an equal cost advertisement");
+}
+
+// Updates that are shorter than their record count are discarded
+class DreamMalformedUpdateTestCase : public DreamProtocolTestCase
+{
+public:
+  DreamMalformedUpdateTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamMalformedUpdateTestCase::DreamMalformedUpdateTestCase ()
+  : DreamProtocolTestCase ("Dream malformed updates")
+{
+}
+
+void
+DreamMalformedUpdateTestCase::DoRun (void)
+{
+  CreateNodes (3, DreamHelper ());
+  Ipv4Address truncated = m_interfaces.GetAddress (1);
+  Ipv4Address valid = m_interfaces.GetAddress (2);
+  // Two records announced, the second one cut off
+  dream::DreamUpdateHeader update (truncated);
+  update.AddRecord (dream::DreamHeader (truncated, 1, 2));
+  update.AddRecord (dream::DreamHeader (Ipv4Address ("10.1.2.1"), 2, 2));
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (update);
+  packet->RemoveAtEnd (dream::DreamHeader::RECORD_SIZE);
+  SchedulePacket (Seconds (1), 1, packet);
+  // Not even the sender block
+  SchedulePacket (Seconds (1.5), 1, Create<Packet> (dream::DreamUpdateHeader::SENDER_BLOCK_SIZE - 1));
+  dream::DreamUpdateHeader fromValid (valid);
+  fromValid.AddRecord (dream::DreamHeader (valid, 1, 2));
+  ScheduleUpdate (Seconds (2), 2, fromValid);
+  Simulator::Schedule (Seconds (3), &DreamMalformedUpdateTestCase::RecordNextHop, this, truncated);
+  Simulator::Schedule (Seconds (3), &DreamMalformedUpdateTestCase::RecordNextHop, this, valid);
+  Simulator::Stop (Seconds (4));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_routing->GetStatistics ().malformedUpdates, 2u, "Malformed updates not counted");
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_nextHops.size (), 2u, "Next hops not recorded");
+  NS_TEST_ASSERT_MSG_NE (m_nextHops[0], truncated, "Route installed from a malformed update");
+  NS_TEST_ASSERT_MSG_EQ (m_nextHops[1], valid, "Route not installed from a valid update");
+}
+
+// Incremental periodic updates carry the changed routes only, between full dumps
+class DreamIncrementalDumpTestCase : public DreamProtocolTestCase
+{
+public:
+  DreamIncrementalDumpTestCase (bool incremental);
+
+private:
+  virtual void DoRun (void);
+  /**
+   * Get the destinations of the periodic update sent around a time, node 0 left out
+   * \param at the time the periodic update is due
+   * \return the destinations
+   */
+  std::vector<Ipv4Address> GetPeriodicDestinations (Time at) const;
+  bool m_incremental;
+};
+
+DreamIncrementalDumpTestCase::DreamIncrementalDumpTestCase (bool incremental)
+  : DreamProtocolTestCase (incremental ? "Dream incremental dump" : "Dream full dumps"),
+    m_incremental (incremental)
+{
+}
+
+std::vector<Ipv4Address>
+DreamIncrementalDumpTestCase::GetPeriodicDestinations (Time at) const
+{
+  std::vector<Ipv4Address> destinations;
+  for (std::vector<std::pair<Time, dream::DreamUpdateHeader> >::const_iterator i = m_updates.begin ();
+       i != m_updates.end (); ++i)
+    {
+      // The periodic updates are due every 15 s, delayed by up to 25 ms each
+      if (i->first < at || i->first > at + MilliSeconds (100))
+        {
+          continue;
+        }
+      const std::vector<dream::DreamHeader> & records = i->second.GetRecords ();
+      for (std::vector<dream::DreamHeader>::const_iterator r = records.begin (); r != records.end (); ++r)
+        {
+          if (r->GetDst () != m_interfaces.GetAddress (0))
+            {
+              destinations.push_back (r->GetDst ());
+            }
+        }
+    }
+  std::sort (destinations.begin (), destinations.end ());
+  return destinations;
+}
+
+void
+DreamIncrementalDumpTestCase::DoRun (void)
+{
+  DreamHelper dream;
+  dream.Set ("EnableIncrementalDump", BooleanValue (m_incremental));
+  dream.Set ("FullDumpPeriod", UintegerValue (3));
+  CreateNodes (2, dream);
+  RecordUpdates (1);
+  Ipv4Address neighbour = m_interfaces.GetAddress (1);
+  Ipv4Address changed ("10.1.2.1");
+  Ipv4Address unchanged ("10.1.3.1");
+  // The neighbour advertises itself and two destinations behind it. The periodic
+  // updates of node 0 follow at about 0, 15, 30 and 45 s, the one at 45 s is a full dump.
+  dream::DreamUpdateHeader update (neighbour);
+  update.AddRecord (dream::DreamHeader (neighbour, 1, 2));
+  update.AddRecord (dream::DreamHeader (changed, 2, 2));
+  update.AddRecord (dream::DreamHeader (unchanged, 2, 2));
+  ScheduleUpdate (Seconds (1), 1, update);
+  // A new sequence number for one destination, the others only refreshed
+  dream::DreamUpdateHeader refresh (neighbour);
+  refresh.AddRecord (dream::DreamHeader (neighbour, 1, 2));
+  refresh.AddRecord (dream::DreamHeader (changed, 2, 4));
+  refresh.AddRecord (dream::DreamHeader (unchanged, 2, 2));
+  ScheduleUpdate (Seconds (20), 1, refresh);
+  ScheduleUpdate (Seconds (35), 1, refresh);
+  Simulator::Stop (Seconds (50));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  std::vector<Ipv4Address> all;
+  all.push_back (neighbour);
+  all.push_back (changed);
+  all.push_back (unchanged);
+  std::sort (all.begin (), all.end ());
+  std::vector<Ipv4Address> first = GetPeriodicDestinations (Seconds (15));
+  std::vector<Ipv4Address> second = GetPeriodicDestinations (Seconds (30));
+  std::vector<Ipv4Address> third = GetPeriodicDestinations (Seconds (45));
+  NS_TEST_ASSERT_MSG_EQ ((first == all), true, "New routes left out of the periodic update");
+  if (m_incremental)
+    {
+      NS_TEST_ASSERT_MSG_EQ (second.size (), 1u, "Unchanged routes sent in an incremental dump");
+      NS_TEST_ASSERT_MSG_EQ ((second.size () == 1 && second[0] == changed), true,
+                             "Changed route left out of the incremental dump");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_EQ ((second == all), true, "Routes left out of a full dump");
+    }
+  NS_TEST_ASSERT_MSG_EQ ((third == all), true, "Routes left out of the full dump");
+}
+
+// A buffered packet leaves the queue once the route to its next hop is learned
+class DreamQueuedRouteTestCase : public DreamProtocolTestCase
+{
+public:
+  DreamQueuedRouteTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DreamQueuedRouteTestCase::DreamQueuedRouteTestCase ()
+  : DreamProtocolTestCase ("Dream queued packet sent once its route resolves")
+{
+}
+
+void
+DreamQueuedRouteTestCase::DoRun (void)
+{
+  CreateNodes (2, DreamHelper ());
+  Ipv4Address neighbour = m_interfaces.GetAddress (1);
+  Ipv4Address dst ("10.1.2.1");
+  // A route to dst through the neighbour, but none to the neighbour yet
+  dream::DreamUpdateHeader update (neighbour);
+  update.AddRecord (dream::DreamHeader (dst, 2, 2));
+  ScheduleUpdate (Seconds (1), 1, update);
+  Simulator::Schedule (Seconds (2), &DreamQueuedRouteTestCase::SendData, this, dst);
+  dream::DreamUpdateHeader self (neighbour);
+  self.AddRecord (dream::DreamHeader (neighbour, 1, 2));
+  ScheduleUpdate (Seconds (3), 1, self);
+  Simulator::Stop (Seconds (4));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_routing->GetStatistics ().enqueued, 1u, "Packet without a usable route not buffered");
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_forwarded.size (), 1u, "Buffered packet not sent");
+  if (m_forwarded.size () == 1)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_forwarded[0].first >= Seconds (3)), true, "Packet sent before its route resolved");
+      NS_TEST_ASSERT_MSG_EQ (m_forwarded[0].second, neighbour, "Packet sent to the wrong next hop");
+    }
+}
+
+// Routes fall over only to the neighbours that advertised as good a metric
+class DreamBackupNextHopTestCase : public DreamProtocolTestCase
+{
+public:
+  DreamBackupNextHopTestCase (bool enable);
+
+private:
+  virtual void DoRun (void);
+  bool m_enable;
+};
+
+DreamBackupNextHopTestCase::DreamBackupNextHopTestCase (bool enable)
+  : DreamProtocolTestCase (enable ? "Dream backup next hops" : "Dream without backup next hops"),
+    m_enable (enable)
+{
+}
+
+void
+DreamBackupNextHopTestCase::DoRun (void)
+{
+  DreamHelper dream;
+  dream.Set ("EnableBackupNextHops", BooleanValue (m_enable));
+  // Changed routes are advertised before the next hops break
+  dream.Set ("EnableWST", BooleanValue (false));
+  dream.Set ("SettlingTime", TimeValue (MilliSeconds (100)));
+  CreateNodes (5, dream);
+  Ipv4Address first = m_interfaces.GetAddress (1);
+  Ipv4Address second = m_interfaces.GetAddress (2);
+  Ipv4Address closer = m_interfaces.GetAddress (3);
+  Ipv4Address dst = m_interfaces.GetAddress (4);
+  // The destination is heard once, without routes, far to the east
+  ScheduleUpdate (Seconds (1), 4, dream::DreamUpdateHeader (dst, 1000, 0));
+  // Closer to the destination, but with no route to it
+  dream::DreamUpdateHeader fromCloser (closer, 200, 0);
+  fromCloser.AddRecord (dream::DreamHeader (closer, 1, 2));
+  ScheduleUpdate (Seconds (2), 3, fromCloser);
+  dream::DreamUpdateHeader fromFirst (first, 0, 200);
+  fromFirst.AddRecord (dream::DreamHeader (first, 1, 2));
+  fromFirst.AddRecord (dream::DreamHeader (dst, 2, 2));
+  ScheduleUpdate (Seconds (3), 1, fromFirst);
+  // The route changes while the closer neighbour is known
+  dream::DreamUpdateHeader shorter (first, 0, 200);
+  shorter.AddRecord (dream::DreamHeader (dst, 1, 4));
+  ScheduleUpdate (Seconds (3.5), 1, shorter);
+  dream::DreamUpdateHeader fromSecond (second, 0, 0);
+  fromSecond.AddRecord (dream::DreamHeader (second, 1, 2));
+  fromSecond.AddRecord (dream::DreamHeader (dst, 1, 4));
+  ScheduleUpdate (Seconds (4), 2, fromSecond);
+  // The next hops in use lose the destination one after the other
+  dream::DreamUpdateHeader brokenFirst (first, 0, 200);
+  brokenFirst.AddRecord (dream::DreamHeader (dst, 1, 5));
+  ScheduleUpdate (Seconds (5), 1, brokenFirst);
+  dream::DreamUpdateHeader brokenSecond (second, 0, 0);
+  brokenSecond.AddRecord (dream::DreamHeader (dst, 1, 5));
+  ScheduleUpdate (Seconds (6), 2, brokenSecond);
+  Simulator::Schedule (Seconds (4.5), &DreamBackupNextHopTestCase::RecordNextHop, this, dst);
+  Simulator::Schedule (Seconds (5.5), &DreamBackupNextHopTestCase::RecordNextHop, this, dst);
+  Simulator::Schedule (Seconds (6.5), &DreamBackupNextHopTestCase::RecordNextHop, this, dst);
+  Simulator::Stop (Seconds (7));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_nextHops.size (), 3u, "Next hops not recorded");
+  NS_TEST_ASSERT_MSG_EQ (m_nextHops[0], first, "First advertiser not used as next hop");
+  if (m_enable)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_nextHops[1], second, "Route not moved to the equal metric advertiser");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_NE (m_nextHops[1], second, "Route moved to a backup next hop while disabled");
+      NS_TEST_ASSERT_MSG_NE (m_nextHops[1], first, "Broken route kept");
+    }
+  NS_TEST_ASSERT_MSG_NE (m_nextHops[2], closer, "Route moved to a neighbour that advertised no route");
+  NS_TEST_ASSERT_MSG_NE (m_nextHops[2], second, "Broken route kept");
+}
+
+// Repeat packets are forwarded from the cache until the route or the local addresses change
+class DreamForwardingCacheTestCase : public DreamProtocolTestCase
+{
+public:
+  DreamForwardingCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /// Make the destination a local address of node 0
+  void AddDestinationAddress ();
+};
+
+DreamForwardingCacheTestCase::DreamForwardingCacheTestCase ()
+  : DreamProtocolTestCase ("Dream forwarding cache")
+{
+}
+
+void
+DreamForwardingCacheTestCase::AddDestinationAddress ()
+{
+  Ptr<Ipv4> ipv4 = m_nodes.Get (0)->GetObject<Ipv4> ();
+  ipv4->AddAddress (1, Ipv4InterfaceAddress (Ipv4Address ("10.1.2.1"), Ipv4Mask ("255.255.255.0")));
+}
+
+void
+DreamForwardingCacheTestCase::DoRun (void)
+{
+  CreateNodes (4, DreamHelper ());
+  Ipv4Address first = m_interfaces.GetAddress (1);
+  Ipv4Address second = m_interfaces.GetAddress (2);
+  Ipv4Address origin = m_interfaces.GetAddress (3);
+  Ipv4Address dst ("10.1.2.1");
+  dream::DreamUpdateHeader fromFirst (first);
+  fromFirst.AddRecord (dream::DreamHeader (first, 1, 2));
+  fromFirst.AddRecord (dream::DreamHeader (dst, 2, 2));
+  ScheduleUpdate (Seconds (1), 1, fromFirst);
+  // The second packet is forwarded from the entry the first one cached
+  Simulator::Schedule (Seconds (2), &DreamForwardingCacheTestCase::ReceiveData, this, origin, dst);
+  Simulator::Schedule (Seconds (2), &DreamForwardingCacheTestCase::ReceiveData, this, origin, dst);
+  // A fresher and shorter route moves the destination to another next hop
+  dream::DreamUpdateHeader fromSecond (second);
+  fromSecond.AddRecord (dream::DreamHeader (second, 1, 2));
+  fromSecond.AddRecord (dream::DreamHeader (dst, 1, 4));
+  ScheduleUpdate (Seconds (3), 2, fromSecond);
+  Simulator::Schedule (Seconds (4), &DreamForwardingCacheTestCase::ReceiveData, this, origin, dst);
+  // Once the destination is a local address, the packets are no longer forwarded
+  Simulator::Schedule (Seconds (5), &DreamForwardingCacheTestCase::AddDestinationAddress, this);
+  Simulator::Schedule (Seconds (6), &DreamForwardingCacheTestCase::ReceiveData, this, origin, dst);
+  Simulator::Stop (Seconds (7));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_forwarded.size (), 3u, "Wrong number of packets forwarded");
+  NS_TEST_ASSERT_MSG_EQ (m_forwarded[0].second, first, "Wrong next hop");
+  NS_TEST_ASSERT_MSG_EQ (m_forwarded[1].second, first, "Wrong next hop for a repeat packet");
+  NS_TEST_ASSERT_MSG_EQ (m_forwarded[2].second, second, "Cached next hop used after the route changed");
+  NS_TEST_ASSERT_MSG_EQ (m_delivered.size (), 1u, "Cached next hop used after the local addresses changed");
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +1713,30 @@ DreamTestSuite::DreamTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new DreamTestCase1, TestCase::QUICK);
+  AddTestCase (new DreamRtableTestCase, TestCase::QUICK);
+  AddTestCase (new DreamRtablePurgeTestCase, TestCase::QUICK);
+  AddTestCase (new DreamRtableSettlingTestCase, TestCase::QUICK);
+  AddTestCase (new DreamRtableRecordTestCase, TestCase::QUICK);
+  AddTestCase (new DreamRtableSnapshotTestCase, TestCase::QUICK);
+  AddTestCase (new DreamRtableGenerationTestCase, TestCase::QUICK);
+  AddTestCase (new DreamRtableBackupTestCase, TestCase::QUICK);
+  AddTestCase (new DreamLocationTestCase, TestCase::QUICK);
+  AddTestCase (new DreamConeTestCase, TestCase::QUICK);
+  AddTestCase (new DreamUpdateHeaderTestCase, TestCase::QUICK);
+  AddTestCase (new DreamPacketQueueTestCase, TestCase::QUICK);
+  AddTestCase (new DreamQueuePolicyTestCase (dream::QUEUE_DROP_TAIL, "drop tail"), TestCase::QUICK);
+  AddTestCase (new DreamQueuePolicyTestCase (dream::QUEUE_DROP_OLDEST, "drop oldest"), TestCase::QUICK);
+  AddTestCase (new DreamQueuePolicyTestCase (dream::QUEUE_FAIR_SHARE, "fair share"), TestCase::QUICK);
+  AddTestCase (new DreamQueueBytesTestCase, TestCase::QUICK);
+  AddTestCase (new DreamGeographicNextHopTestCase (false), TestCase::QUICK);
+  AddTestCase (new DreamGeographicNextHopTestCase (true), TestCase::QUICK);
+  AddTestCase (new DreamMalformedUpdateTestCase, TestCase::QUICK);
+  AddTestCase (new DreamIncrementalDumpTestCase (false), TestCase::QUICK);
+  AddTestCase (new DreamIncrementalDumpTestCase (true), TestCase::QUICK);
+  AddTestCase (new DreamQueuedRouteTestCase, TestCase::QUICK);
+  AddTestCase (new DreamBackupNextHopTestCase (false), TestCase::QUICK);
+  AddTestCase (new DreamBackupNextHopTestCase (true), TestCase::QUICK);
+  AddTestCase (new DreamForwardingCacheTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
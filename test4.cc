@@ -65,6 +65,8 @@
  *   left commented inline in the program
  */
  
+#include <chrono>
+#include <sys/resource.h>
 #include <fstream>
 #include <iostream>
 #include "ns3/core-module.h"
@@ -77,6 +79,7 @@
 #include "ns3/dsdv-module.h"
 #include "ns3/dsr-module.h"
 #include "ns3/applications-module.h"
+#include "ns3/flow-monitor-module.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/energy-module.h"
 #include "ns3/wifi-radio-energy-model-helper.h"
@@ -94,6 +97,10 @@ public:
   //static void SetMACParam (ns3::NetDeviceContainer & devices,
   //                                 int slotDistance);
   std::string CommandSetup (int argc, char **argv);
+  void RunQueuePolicyComparison (double txp, std::string CSVfileName);
+  bool CompareQueuePolicies () const { return m_compareQueuePolicies; }
+  void RunBackupNextHopComparison (double txp, std::string CSVfileName);
+  bool CompareBackupNextHops () const { return m_compareBackupNextHops; }
  
 private:
   Ptr<Socket> SetupPacketReceive (Ipv4Address addr, Ptr<Node> node);
@@ -106,13 +113,23 @@ private:
  
   std::string m_CSVfileName;  
   int nSinks=5;
-  int nWifis=15;
-  int nodeSpeed=10;
+  int nWifis=50;
+  int nodeSpeed=20;
   int pktpersec=100;              
   std::string m_protocolName; 
   double m_txp;               
   bool m_traceMobility;       
   uint32_t m_protocol;        
+  bool m_dreamIncrementalDump;
+  uint32_t m_dreamFullDumpPeriod;
+  std::string m_dreamQueuePolicy;
+  bool m_compareQueuePolicies;
+  uint32_t m_dreamMaxQueueBytes;
+  bool m_dreamBackupNextHops;
+  bool m_compareBackupNextHops;
+  double m_deliveryRatio;
+  double m_meanDelay;
+  dream::DreamStatistics m_dreamStatistics;
 };
  
 RoutingExperiment::RoutingExperiment ()
@@ -121,7 +138,16 @@ RoutingExperiment::RoutingExperiment ()
     packetsReceived (0),
     m_CSVfileName ("baseline.csv"),
     m_traceMobility (false),
-    m_protocol (3) // DSDV
+    m_protocol (3), // DSDV
+    m_dreamIncrementalDump (false),
+    m_dreamFullDumpPeriod (5),
+    m_dreamQueuePolicy ("DropTail"),
+    m_compareQueuePolicies (false),
+    m_dreamMaxQueueBytes (0),
+    m_dreamBackupNextHops (false),
+    m_compareBackupNextHops (false),
+    m_deliveryRatio (0),
+    m_meanDelay (0)
 {
 }
  
@@ -194,13 +220,20 @@ std::string
 RoutingExperiment::CommandSetup (int argc, char **argv)
 {
   CommandLine cmd (__FILE__);
-  cmd.AddValue ("nWifis", "", nWifis);
+  cmd.AddValue ("nWifis", "Number of nodes", nWifis);
   cmd.AddValue ("nSinks", "", nSinks);
   cmd.AddValue ("pktpersec", "", pktpersec);
-  cmd.AddValue ("nodeSpeed", "", nodeSpeed);
+  cmd.AddValue ("nodeSpeed", "Maximum node speed in m/s", nodeSpeed);
   cmd.AddValue ("CSVfileName", "The name of the CSV output file name", m_CSVfileName);
   cmd.AddValue ("traceMobility", "Enable mobility tracing", m_traceMobility);
   cmd.AddValue ("protocol", "1=OLSR;2=DREAM;3=DSDV;4=DSR", m_protocol);
+  cmd.AddValue ("dreamIncrementalDump", "Send incremental DREAM periodic updates between full dumps", m_dreamIncrementalDump);
+  cmd.AddValue ("dreamFullDumpPeriod", "Number of DREAM periodic updates between full dumps", m_dreamFullDumpPeriod);
+  cmd.AddValue ("dreamQueuePolicy", "DREAM queue policy: DropTail, DropOldest or FairShare", m_dreamQueuePolicy);
+  cmd.AddValue ("dreamMaxQueueBytes", "Maximum number of bytes buffered by DREAM, 0 for no limit", m_dreamMaxQueueBytes);
+  cmd.AddValue ("compareQueuePolicies", "Run DREAM once per queue policy and compare delivery ratio and delay", m_compareQueuePolicies);
+  cmd.AddValue ("dreamBackupNextHops", "Let DREAM routes fall over to backup next hops", m_dreamBackupNextHops);
+  cmd.AddValue ("compareBackupNextHops", "Run DREAM without and with backup next hops and compare the time packets stall in the queue", m_compareBackupNextHops);
   cmd.Parse (argc, argv);
   return m_CSVfileName;
 }
@@ -225,7 +258,53 @@ main (int argc, char *argv[])
   
   double txp = 7.5;
  
-  experiment.Run ( txp, CSVfileName);
+  if (experiment.CompareQueuePolicies ())
+    {
+      experiment.RunQueuePolicyComparison (txp, CSVfileName);
+    }
+  else if (experiment.CompareBackupNextHops ())
+    {
+      experiment.RunBackupNextHopComparison (txp, CSVfileName);
+    }
+  else
+    {
+      experiment.Run ( txp, CSVfileName);
+    }
+}
+
+void
+RoutingExperiment::RunQueuePolicyComparison (double txp, std::string CSVfileName)
+{
+  const char *policies[] = { "DropTail", "DropOldest", "FairShare" };
+  std::ostringstream summary;
+  m_protocol = 2;
+  for (const char *policy : policies)
+    {
+      m_dreamQueuePolicy = policy;
+      Run (txp, CSVfileName);
+      summary << policy << "," << m_deliveryRatio << "," << m_meanDelay << std::endl;
+    }
+  std::cout << "QueuePolicy,DeliveryRatio,MeanDelay" << std::endl << summary.str ();
+}
+
+void
+RoutingExperiment::RunBackupNextHopComparison (double txp, std::string CSVfileName)
+{
+  std::ostringstream summary;
+  m_protocol = 2;
+  for (bool backups : { false, true })
+    {
+      m_dreamBackupNextHops = backups;
+      Run (txp, CSVfileName);
+      // Packets stall in the queue from the loss of their route until a new one is learned
+      summary << backups << "," << m_deliveryRatio << "," << m_meanDelay << ","
+              << m_dreamStatistics.enqueued << "," << m_dreamStatistics.maxOccupancy << ","
+              << m_dreamStatistics.totalSojourn.GetSeconds () << ","
+              << (m_dreamStatistics.dequeued ? m_dreamStatistics.totalSojourn.GetSeconds () / m_dreamStatistics.dequeued : 0)
+              << "," << m_dreamStatistics.failovers << std::endl;
+    }
+  std::cout << "BackupNextHops,DeliveryRatio,MeanDelay,Buffered,MaxBuffered,TotalStall,MeanStall,Failovers"
+            << std::endl << summary.str ();
 }
  
 void
@@ -236,15 +315,12 @@ RoutingExperiment::Run ( double txp, std::string CSVfileName)
   m_txp = txp;
   m_CSVfileName = CSVfileName;
  
-  int nWifis = 50;
- 
   std::ofstream out (CSVfileName.c_str ());
   double TotalTime = 110.0;
   std::string rate (std::to_string(pktpersec*64)+"bps");
 
   std::string phyMode ("DsssRate11Mbps");
   //std::string tr_name ("baseline");
-  int nodeSpeed = 20; //in m/s
   int nodePause = 0; //in s
   m_protocolName = "protocol";
  
@@ -254,6 +330,7 @@ RoutingExperiment::Run ( double txp, std::string CSVfileName)
   //Set Non-unicastMode rate to unicast mode
   Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode",StringValue (phyMode));
  
+  NS_ABORT_MSG_IF (2 * nSinks > nWifis, "Every sink needs a source, use nWifis >= 2 * nSinks");
   NodeContainer adhocNodes;
   adhocNodes.Create (nWifis);
  
@@ -314,6 +391,11 @@ RoutingExperiment::Run ( double txp, std::string CSVfileName)
   // install device model
   DeviceEnergyModelContainer deviceModels = radioEnergyHelper.Install (adhocDevices, sources);
   DreamHelper dream;
+  dream.Set ("EnableIncrementalDump", BooleanValue (m_dreamIncrementalDump));
+  dream.Set ("FullDumpPeriod", UintegerValue (m_dreamFullDumpPeriod));
+  dream.Set ("QueuePolicy", StringValue (m_dreamQueuePolicy));
+  dream.Set ("MaxQueueBytes", UintegerValue (m_dreamMaxQueueBytes));
+  dream.Set ("EnableBackupNextHops", BooleanValue (m_dreamBackupNextHops));
   OlsrHelper olsr;
   DsdvHelper dsdv;
   DsrHelper dsr;
@@ -402,9 +484,9 @@ RoutingExperiment::Run ( double txp, std::string CSVfileName)
   //AsciiTraceHelper ascii;
   //MobilityHelper::EnableAsciiAll (ascii.CreateFileStream (tr_name + ".mob"));
  
-  //Ptr<FlowMonitor> flowmon;
-  //FlowMonitorHelper flowmonHelper;
-  //flowmon = flowmonHelper.InstallAll ();
+  Ptr<FlowMonitor> flowmon;
+  FlowMonitorHelper flowmonHelper;
+  flowmon = flowmonHelper.InstallAll ();
  
  
   NS_LOG_INFO ("Run Simulation.");
@@ -412,7 +494,19 @@ RoutingExperiment::Run ( double txp, std::string CSVfileName)
   CheckThroughput ();
  
   Simulator::Stop (Seconds (TotalTime));
+  // Wall-clock time of the run, the control plane cost when there are no sinks
+  std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now ();
   Simulator::Run ();
+  double runTime = std::chrono::duration<double> (std::chrono::steady_clock::now () - runStart).count ();
+  std::cout << m_protocolName << " Nodes=" << nWifis << " Sinks=" << nSinks
+            << " RunTime=" << runTime << "s" << std::endl;
+  // Peak resident set size of the process, in kilobytes on Linux
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    {
+      std::cout << m_protocolName << " Nodes=" << nWifis
+                << " MaxRSS=" << usage.ru_maxrss << "kB" << std::endl;
+    }
    double total=0.0;
     for (DeviceEnergyModelContainer::Iterator iter = deviceModels.Begin (); iter != deviceModels.End (); iter ++)
     {
@@ -423,6 +517,47 @@ RoutingExperiment::Run ( double txp, std::string CSVfileName)
       NS_ASSERT (energyConsumed <= 0.1);
     }
   //flowmon->SerializeToXmlFile ((tr_name + ".flowmon").c_str(), false, false);
+  // Delivery ratio and delay of the data flows, and the bytes DREAM sends to its own port
+  flowmon->CheckForLostPackets ();
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmonHelper.GetClassifier ());
+  uint64_t txPackets = 0;
+  uint64_t rxPackets = 0;
+  uint64_t controlBytes = 0;
+  Time delaySum;
+  FlowMonitor::FlowStatsContainer stats = flowmon->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      Ipv4FlowClassifier::FiveTuple flow = classifier->FindFlow (i->first);
+      if (flow.destinationPort == dream::DreamRoutingProtocol::DREAM_PORT)
+        {
+          controlBytes += i->second.txBytes;
+          continue;
+        }
+      if (flow.destinationPort != port)
+        {
+          continue;
+        }
+      txPackets += i->second.txPackets;
+      rxPackets += i->second.rxPackets;
+      delaySum += i->second.delaySum;
+    }
+  m_deliveryRatio = txPackets ? (double) rxPackets / txPackets : 0;
+  m_meanDelay = rxPackets ? delaySum.GetSeconds () / rxPackets : 0;
+  std::cout << m_protocolName << " DeliveryRatio=" << m_deliveryRatio
+            << " MeanDelay=" << m_meanDelay << "s"
+            << " DataPacketsPerRunSecond=" << (runTime > 0 ? txPackets / runTime : 0);
+  if (m_protocol == 2)
+    {
+      std::cout << " ControlBytes=" << controlBytes;
+    }
+  std::cout << std::endl;
+  if (m_protocol == 2)
+    {
+      m_dreamStatistics = DreamHelper::GetStatistics (adhocNodes);
+      std::cout << "DREAM ";
+      m_dreamStatistics.Print (std::cout);
+      std::cout << std::endl;
+    }
  
   Simulator::Destroy ();
 }
\ No newline at end of file